@@ -0,0 +1,135 @@
+#include "async_search_server.h"
+
+#include <algorithm>
+#include <execution>
+#include <iterator>
+
+void AsyncSearchServer::PendingQuery::Cancel() const {
+    *is_cancelled = true;
+}
+
+AsyncSearchServer::AsyncSearchServer(const SearchServer& search_server, std::chrono::microseconds batch_window, size_t max_batch_size)
+    : search_server_(search_server)
+    , batch_window_(batch_window)
+    , max_batch_size_(std::max<size_t>(max_batch_size, 1))
+    , dispatcher_([this] { RunDispatcher(); })
+{
+}
+
+AsyncSearchServer::~AsyncSearchServer() {
+    {
+        std::lock_guard guard(mutex_);
+        stop_ = true;
+    }
+    queue_changed_.notify_all();
+    dispatcher_.join();
+}
+
+AsyncSearchServer::PendingQuery AsyncSearchServer::SubmitFindTopDocuments(std::string_view raw_query, DocumentStatus status,
+                                                                          Clock::time_point deadline) {
+    return SubmitFindTopDocuments(raw_query, [status](int document_id, DocumentStatus document_status, int rating) {
+        return document_status == status;
+    }, deadline);
+}
+
+AsyncSearchServer::PendingQuery AsyncSearchServer::SubmitFindTopDocuments(std::string_view raw_query) {
+    return SubmitFindTopDocuments(raw_query, DocumentStatus::ACTUAL);
+}
+
+AsyncSearchServer::PendingQuery AsyncSearchServer::Enqueue(Request request) {
+    request.is_cancelled = std::make_shared<std::atomic_bool>(false);
+    PendingQuery pending{request.result.get_future(), request.is_cancelled};
+    {
+        std::lock_guard guard(mutex_);
+        requests_.push_back(std::move(request));
+    }
+    queue_changed_.notify_one();
+    return pending;
+}
+
+void AsyncSearchServer::RunDispatcher() {
+    std::vector<Request> batch;
+    while (true) {
+        {
+            std::unique_lock lock(mutex_);
+            queue_changed_.wait(lock, [this] { return stop_ || !requests_.empty(); });
+            if (stop_ && requests_.empty()) {
+                return;
+            }
+
+            // Requests cancelled or expired while the previous batch ran are failed now
+            // rather than when they reach a batch, which can be many windows away
+            std::vector<Request> rejected = TakeRejectedRequests(Clock::now());
+            if (!rejected.empty()) {
+                lock.unlock();
+                for (Request& request : rejected) {
+                    RejectRequest(request, Clock::now());
+                }
+                continue;
+            }
+
+            // The first request opens the window, the batch closes when the window
+            // expires or the batch is full
+            const auto window_end = Clock::now() + batch_window_;
+            queue_changed_.wait_until(lock, window_end, [this] {
+                return stop_ || requests_.size() >= max_batch_size_;
+            });
+
+            const size_t batch_size = std::min(requests_.size(), max_batch_size_);
+            for (size_t i = 0; i < batch_size; ++i) {
+                batch.push_back(std::move(requests_.front()));
+                requests_.pop_front();
+            }
+        }
+
+        ProcessBatch(batch);
+        batch.clear();
+    }
+}
+
+std::vector<AsyncSearchServer::Request> AsyncSearchServer::TakeRejectedRequests(Clock::time_point now) {
+    const auto accepted_end = std::stable_partition(requests_.begin(), requests_.end(), [now](const Request& request) {
+        return !*request.is_cancelled && now <= request.deadline;
+    });
+    std::vector<Request> rejected(std::make_move_iterator(accepted_end), std::make_move_iterator(requests_.end()));
+    requests_.erase(accepted_end, requests_.end());
+    return rejected;
+}
+
+bool AsyncSearchServer::RejectRequest(Request& request, Clock::time_point now) {
+    using namespace std::string_literals;
+    if (*request.is_cancelled) {
+        request.result.set_exception(std::make_exception_ptr(QueryCancelledError("Query is cancelled"s)));
+        return true;
+    }
+    if (now > request.deadline) {
+        request.result.set_exception(std::make_exception_ptr(QueryDeadlineError("Query deadline is exceeded"s)));
+        return true;
+    }
+    return false;
+}
+
+void AsyncSearchServer::ProcessBatch(std::vector<Request>& batch) const {
+    // Equal and similar queries next to each other reuse the same postings in cache
+    std::sort(batch.begin(), batch.end(), [](const Request& lhs, const Request& rhs) {
+        return lhs.raw_query < rhs.raw_query;
+    });
+
+    if (ThreadPool* executor = search_server_.GetExecutor()) {
+        executor->ForEach(batch.begin(), batch.end(), [this](Request& request) { ProcessRequest(request); });
+    } else {
+        std::for_each(std::execution::par, batch.begin(), batch.end(), [this](Request& request) { ProcessRequest(request); });
+    }
+}
+
+void AsyncSearchServer::ProcessRequest(Request& request) const {
+    // Cancellation and deadline are checked again for the requests that came during the window
+    if (RejectRequest(request, Clock::now())) {
+        return;
+    }
+    try {
+        request.result.set_value(search_server_.FindTopDocuments(request.raw_query, request.document_predicate));
+    } catch (...) {
+        request.result.set_exception(std::current_exception());
+    }
+}
@@ -0,0 +1,98 @@
+#pragma once
+#include "search_server.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+class QueryCancelledError : public std::runtime_error {
+public:
+    using std::runtime_error::runtime_error;
+};
+
+class QueryDeadlineError : public std::runtime_error {
+public:
+    using std::runtime_error::runtime_error;
+};
+
+// Non-blocking front end over SearchServer. Submitted queries are queued, requests that
+// arrive within batch_window are coalesced into one batch, sorted by query text and
+// executed together (on the server's executor when it is set).
+// The future gets QueryCancelledError or QueryDeadlineError instead of documents when
+// the query was cancelled or its deadline passed before execution. Such queries are
+// swept out of the queue whenever a window opens, so they fail without waiting for
+// the batches ahead of them
+class AsyncSearchServer {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    struct PendingQuery {
+        std::future<std::vector<Document>> result;
+        std::shared_ptr<std::atomic_bool> is_cancelled;
+
+        void Cancel() const;
+    };
+
+    explicit AsyncSearchServer(const SearchServer& search_server,
+                               std::chrono::microseconds batch_window = std::chrono::microseconds(50),
+                               size_t max_batch_size = 64);
+    ~AsyncSearchServer();
+
+    AsyncSearchServer(const AsyncSearchServer&) = delete;
+    AsyncSearchServer& operator=(const AsyncSearchServer&) = delete;
+
+    template <typename DocumentPredicate>
+    PendingQuery SubmitFindTopDocuments(std::string_view raw_query, DocumentPredicate document_predicate,
+                                        Clock::time_point deadline = Clock::time_point::max());
+    PendingQuery SubmitFindTopDocuments(std::string_view raw_query, DocumentStatus status,
+                                        Clock::time_point deadline = Clock::time_point::max());
+    PendingQuery SubmitFindTopDocuments(std::string_view raw_query);
+
+private:
+    struct Request {
+        std::string raw_query;
+        std::function<bool(int, DocumentStatus, int)> document_predicate;
+        Clock::time_point deadline;
+        std::shared_ptr<std::atomic_bool> is_cancelled;
+        std::promise<std::vector<Document>> result;
+    };
+
+    const SearchServer& search_server_;
+    const std::chrono::microseconds batch_window_;
+    const size_t max_batch_size_;
+
+    std::mutex mutex_;
+    std::condition_variable queue_changed_;
+    std::deque<Request> requests_;
+    bool stop_ = false;
+
+    std::thread dispatcher_;
+
+    PendingQuery Enqueue(Request request);
+    void RunDispatcher();
+    // Takes the cancelled and expired requests out of requests_, mutex_ must be held
+    std::vector<Request> TakeRejectedRequests(Clock::time_point now);
+    // Fails the future of a cancelled or expired request, returns whether it did
+    static bool RejectRequest(Request& request, Clock::time_point now);
+    void ProcessBatch(std::vector<Request>& batch) const;
+    void ProcessRequest(Request& request) const;
+};
+
+template <typename DocumentPredicate>
+AsyncSearchServer::PendingQuery AsyncSearchServer::SubmitFindTopDocuments(std::string_view raw_query, DocumentPredicate document_predicate,
+                                                                          Clock::time_point deadline) {
+    Request request;
+    request.raw_query = std::string(raw_query);
+    request.document_predicate = document_predicate;
+    request.deadline = deadline;
+    return Enqueue(std::move(request));
+}
@@ -1,48 +1,114 @@
 #pragma once
 
-#include <map>
+#include <atomic>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <string>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
 #include <vector>
-#include <mutex>
 
+using namespace std::string_literals;
+
+// Lock-free open-addressing hash map for accumulating arithmetic values by integer key.
+// Slots hold an atomic key and an atomic value: a key is claimed with compare-exchange,
+// values are added with fetch_add (compare-exchange loop for floating point).
+// Every slot is padded to a cache line, so threads adding to different keys never
+// write to the same line, at the cost of CACHE_LINE_SIZE bytes per slot.
+// ForEach and BuildVector must not run concurrently with Add
 template <typename Key, typename Value>
 class ConcurrentMap {
-private:
-    struct Bucket {
-        std::mutex mutex;
-        std::map<Key, Value> map;
-    };
-    std::vector<Bucket> buckets_;
-
 public:
     static_assert(std::is_integral_v<Key>, "ConcurrentMap supports only integer keys"s);
+    static_assert(std::is_arithmetic_v<Value>, "ConcurrentMap supports only arithmetic values"s);
+
+    static constexpr size_t CACHE_LINE_SIZE = 64;
 
-    struct Access {
-        std::lock_guard<std::mutex> guard;
-        Value& ref_to_value;
+    // The maximum key value is reserved as the empty slot marker
+    static constexpr Key EMPTY_KEY = std::numeric_limits<Key>::max();
 
-        Access(const Key& key, Bucket& bucket)
-            : guard(bucket.mutex)
-            , ref_to_value(bucket.map[key]) {
+    // Holds up to max_key_count distinct keys, the table is kept at most half full
+    explicit ConcurrentMap(size_t max_key_count)
+        : mask_(GetTableSize(max_key_count) - 1)
+        , slots_(new Slot[mask_ + 1]) {
+        for (size_t i = 0; i <= mask_; ++i) {
+            slots_[i].key.store(EMPTY_KEY, std::memory_order_relaxed);
+            slots_[i].value.store(Value{}, std::memory_order_relaxed);
         }
-    };
+    }
 
-    explicit ConcurrentMap(size_t bucket_count)
-        : buckets_(bucket_count) {
+    void Add(Key key, Value delta) {
+        if (key == EMPTY_KEY) {
+            throw std::invalid_argument("Key is reserved"s);
+        }
+        size_t index = Hash(key) & mask_;
+        for (size_t probe = 0; probe <= mask_; ++probe) {
+            Slot& slot = slots_[index];
+            Key current = slot.key.load(std::memory_order_acquire);
+            if (current == EMPTY_KEY) {
+                // On failure current gets the key inserted by another thread
+                slot.key.compare_exchange_strong(current, key, std::memory_order_acq_rel);
+                if (current == EMPTY_KEY) {
+                    current = key;
+                }
+            }
+            if (current == key) {
+                AddValue(slot.value, delta);
+                return;
+            }
+            index = (index + 1) & mask_;
+        }
+        throw std::length_error("ConcurrentMap is full"s);
     }
 
-    Access operator[](const Key& key) {
-        uint64_t index = key % buckets_.size();
-        return {key, buckets_[index]};
+    template <typename Function>
+    void ForEach(Function function) const {
+        for (size_t i = 0; i <= mask_; ++i) {
+            const Key key = slots_[i].key.load(std::memory_order_acquire);
+            if (key != EMPTY_KEY) {
+                function(key, slots_[i].value.load(std::memory_order_relaxed));
+            }
+        }
     }
 
-    std::map<Key, Value> BuildOrdinaryMap() {
-        std::map<Key, Value> result;
+    // Key-value pairs in table order
+    std::vector<std::pair<Key, Value>> BuildVector() const {
+        std::vector<std::pair<Key, Value>> result;
+        ForEach([&result](Key key, Value value) { result.emplace_back(key, value); });
+        return result;
+    }
+
+private:
+    struct alignas(CACHE_LINE_SIZE) Slot {
+        std::atomic<Key> key;
+        std::atomic<Value> value;
+    };
+
+    const size_t mask_;
+    std::unique_ptr<Slot[]> slots_;
 
-        for (auto& bucket : buckets_) {
-            std::lock_guard g(bucket.mutex);
-            result.merge(bucket.map);
+    static size_t GetTableSize(size_t max_key_count) {
+        size_t size = 16;
+        while (size < max_key_count * 2) {
+            size *= 2;
         }
+        return size;
+    }
 
-        return result;
+    // Fibonacci hashing spreads consecutive document ids over the table
+    static size_t Hash(Key key) {
+        return static_cast<size_t>((static_cast<uint64_t>(key) * 11400714819323198485ull) >> 32);
+    }
+
+    static void AddValue(std::atomic<Value>& value, Value delta) {
+        if constexpr (std::is_integral_v<Value>) {
+            value.fetch_add(delta, std::memory_order_relaxed);
+        } else {
+            Value current = value.load(std::memory_order_relaxed);
+            while (!value.compare_exchange_weak(current, current + delta, std::memory_order_relaxed)) {
+            }
+        }
     }
 };
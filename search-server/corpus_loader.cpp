@@ -0,0 +1,234 @@
+#include "corpus_loader.h"
+
+#include <algorithm>
+#include <charconv>
+#include <exception>
+#include <execution>
+#include <fstream>
+#include <stdexcept>
+#include <thread>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define CORPUS_USE_MMAP
+#endif
+
+double CorpusLoadStats::GetMegabytesPerSecond() const {
+    return seconds > 0.0 ? byte_count / (1024.0 * 1024.0) / seconds : 0.0;
+}
+
+double CorpusLoadStats::GetDocumentsPerSecond() const {
+    return seconds > 0.0 ? document_count / seconds : 0.0;
+}
+
+std::ostream& operator<<(std::ostream& out, const CorpusLoadStats& stats) {
+    out << stats.document_count << " documents, "s
+        << stats.byte_count << " bytes in "s << stats.seconds << " s ("s
+        << stats.GetDocumentsPerSecond() << " documents/s, "s
+        << stats.GetMegabytesPerSecond() << " MB/s)"s;
+    return out;
+}
+
+CorpusFile::CorpusFile(const std::string& path) {
+#ifdef CORPUS_USE_MMAP
+    const int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw std::runtime_error("Cannot open corpus file "s + path);
+    }
+    struct stat file_stat;
+    if (fstat(fd, &file_stat) < 0) {
+        close(fd);
+        throw std::runtime_error("Cannot read corpus file "s + path);
+    }
+    size_ = file_stat.st_size;
+    if (size_ > 0) {
+        void* data = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (data == MAP_FAILED) {
+            close(fd);
+            throw std::runtime_error("Cannot map corpus file "s + path);
+        }
+        madvise(data, size_, MADV_SEQUENTIAL);
+        data_ = static_cast<const char*>(data);
+        is_mapped_ = true;
+    }
+    close(fd);
+#else
+    std::ifstream input(path, std::ios::binary);
+    if (!input) {
+        throw std::runtime_error("Cannot open corpus file "s + path);
+    }
+    input.seekg(0, std::ios::end);
+    buffer_.resize(static_cast<size_t>(input.tellg()));
+    input.seekg(0);
+    input.read(buffer_.data(), buffer_.size());
+    data_ = buffer_.data();
+    size_ = buffer_.size();
+#endif
+}
+
+CorpusFile::~CorpusFile() {
+#ifdef CORPUS_USE_MMAP
+    if (is_mapped_) {
+        munmap(const_cast<char*>(data_), size_);
+    }
+#endif
+}
+
+std::string_view CorpusFile::GetData() const {
+    return {data_, size_};
+}
+
+namespace {
+
+std::string_view ExtractField(std::string_view& line) {
+    const size_t tab = line.find('\t');
+    if (tab == line.npos) {
+        throw std::invalid_argument("Corpus record has too few fields: "s + std::string(line));
+    }
+    const std::string_view field = line.substr(0, tab);
+    line.remove_prefix(tab + 1);
+    return field;
+}
+
+int ParseInt(std::string_view text) {
+    int value = 0;
+    const auto [end, error] = std::from_chars(text.data(), text.data() + text.size(), value);
+    if (error != std::errc() || end != text.data() + text.size()) {
+        throw std::invalid_argument("Invalid number in corpus record: "s + std::string(text));
+    }
+    return value;
+}
+
+DocumentStatus ParseStatus(std::string_view text) {
+    using namespace std::string_view_literals;
+    if (text == "ACTUAL"sv) {
+        return DocumentStatus::ACTUAL;
+    }
+    if (text == "IRRELEVANT"sv) {
+        return DocumentStatus::IRRELEVANT;
+    }
+    if (text == "BANNED"sv) {
+        return DocumentStatus::BANNED;
+    }
+    if (text == "REMOVED"sv) {
+        return DocumentStatus::REMOVED;
+    }
+    throw std::invalid_argument("Invalid document status: "s + std::string(text));
+}
+
+// Fields of the line, the ratings are appended to ratings rather than to record.ratings
+void ParseRecordFields(std::string_view line, CorpusRecord& record, std::vector<int>& ratings) {
+    record.document_id = ParseInt(ExtractField(line));
+    record.status = ParseStatus(ExtractField(line));
+
+    std::string_view ratings_text = ExtractField(line);
+    while (!ratings_text.empty()) {
+        const size_t space = std::min(ratings_text.find(' '), ratings_text.size());
+        if (space > 0) {
+            ratings.push_back(ParseInt(ratings_text.substr(0, space)));
+        }
+        ratings_text.remove_prefix(std::min(space + 1, ratings_text.size()));
+    }
+
+    record.text = line;
+}
+
+// Pieces of about target_size bytes, each ends at the end of a line
+std::vector<std::string_view> SplitLines(std::string_view data, size_t target_size) {
+    std::vector<std::string_view> pieces;
+    while (!data.empty()) {
+        size_t piece_end = std::min(target_size, data.size());
+        piece_end = std::min(data.find('\n', piece_end - 1), data.size() - 1) + 1;
+        pieces.push_back(data.substr(0, piece_end));
+        data.remove_prefix(piece_end);
+    }
+    return pieces;
+}
+
+// Records of a chunk keep empty ratings, theirs are stored one after another in ratings
+// so that a chunk allocates a few arrays rather than one per record
+struct ParsedChunk {
+    std::vector<CorpusRecord> records;
+    std::vector<size_t> ratings_ends;
+    std::vector<int> ratings;
+    // Exceptions cannot leave a parallel algorithm, the first error waits here
+    std::exception_ptr error;
+};
+
+void ParseChunk(std::string_view chunk, ParsedChunk& parsed) {
+    parsed.records.clear();
+    parsed.ratings_ends.clear();
+    parsed.ratings.clear();
+    parsed.error = nullptr;
+    try {
+        while (!chunk.empty()) {
+            const size_t line_end = std::min(chunk.find('\n'), chunk.size());
+            std::string_view line = chunk.substr(0, line_end);
+            chunk.remove_prefix(std::min(line_end + 1, chunk.size()));
+
+            if (!line.empty() && line.back() == '\r') {
+                line.remove_suffix(1);
+            }
+            if (!line.empty()) {
+                ParseRecordFields(line, parsed.records.emplace_back(), parsed.ratings);
+                parsed.ratings_ends.push_back(parsed.ratings.size());
+            }
+        }
+    } catch (...) {
+        parsed.error = std::current_exception();
+    }
+}
+
+}  // namespace
+
+CorpusRecord ParseCorpusRecord(std::string_view line) {
+    CorpusRecord record;
+    ParseRecordFields(line, record, record.ratings);
+    return record;
+}
+
+void ForEachCorpusRecord(std::string_view data, const std::function<void(const CorpusRecord&)>& add_record,
+                         ThreadPool* executor) {
+    // A few chunks per thread in every window
+    const size_t thread_count = executor ? executor->GetThreadCount() : std::max(1u, std::thread::hardware_concurrency());
+    const size_t target_chunk_size = std::max<size_t>(CORPUS_WINDOW_SIZE / (thread_count * 4), 1 << 16);
+
+    // Buffers are reused from window to window
+    std::vector<ParsedChunk> parsed_chunks;
+    CorpusRecord record;
+    for (const std::string_view window : SplitLines(data, CORPUS_WINDOW_SIZE)) {
+        const auto chunks = SplitLines(window, target_chunk_size);
+        if (parsed_chunks.size() < chunks.size()) {
+            parsed_chunks.resize(chunks.size());
+        }
+        const auto parse = [&](const std::string_view& chunk) {
+            ParseChunk(chunk, parsed_chunks[&chunk - chunks.data()]);
+        };
+        if (executor) {
+            executor->ForEach(chunks.begin(), chunks.end(), parse);
+        } else {
+            std::for_each(std::execution::par, chunks.begin(), chunks.end(), parse);
+        }
+
+        for (size_t i = 0; i < chunks.size(); ++i) {
+            if (parsed_chunks[i].error) {
+                std::rethrow_exception(parsed_chunks[i].error);
+            }
+        }
+        for (size_t i = 0; i < chunks.size(); ++i) {
+            const ParsedChunk& parsed = parsed_chunks[i];
+            size_t ratings_begin = 0;
+            for (size_t j = 0; j < parsed.records.size(); ++j) {
+                record.document_id = parsed.records[j].document_id;
+                record.status = parsed.records[j].status;
+                record.text = parsed.records[j].text;
+                record.ratings.assign(parsed.ratings.begin() + ratings_begin, parsed.ratings.begin() + parsed.ratings_ends[j]);
+                ratings_begin = parsed.ratings_ends[j];
+                add_record(record);
+            }
+        }
+    }
+}
@@ -0,0 +1,96 @@
+#pragma once
+#include "document.h"
+#include "thread_pool.h"
+
+#include <chrono>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Corpus file format, one document per line:
+// id<TAB>status<TAB>ratings<TAB>text
+// status is ACTUAL, IRRELEVANT, BANNED or REMOVED, ratings are separated by spaces
+
+struct CorpusRecord {
+    int document_id = 0;
+    DocumentStatus status = DocumentStatus::ACTUAL;
+    std::vector<int> ratings;
+    std::string_view text;  // Points into the file data
+};
+
+struct CorpusLoadStats {
+    size_t byte_count = 0;
+    size_t document_count = 0;
+    double seconds = 0.0;
+
+    double GetMegabytesPerSecond() const;
+    double GetDocumentsPerSecond() const;
+};
+
+std::ostream& operator<<(std::ostream& out, const CorpusLoadStats& stats);
+
+// Whole file as one read-only buffer: memory-mapped on POSIX systems, read in one piece elsewhere
+class CorpusFile {
+public:
+    explicit CorpusFile(const std::string& path);
+    ~CorpusFile();
+
+    CorpusFile(const CorpusFile&) = delete;
+    CorpusFile& operator=(const CorpusFile&) = delete;
+
+    std::string_view GetData() const;
+
+private:
+    const char* data_ = nullptr;
+    size_t size_ = 0;
+    bool is_mapped_ = false;
+    std::string buffer_;
+};
+
+CorpusRecord ParseCorpusRecord(std::string_view line);
+
+// Bytes of the corpus parsed before their records are added, bounds the parsed records in memory
+const size_t CORPUS_WINDOW_SIZE = 16 << 20;
+
+// Splits data into windows of about CORPUS_WINDOW_SIZE bytes on line boundaries. Each window
+// is split into chunks parsed in parallel, on the executor when it is set, and then its records
+// go to add_record in file order before the next window is parsed. The record passed is reused
+// for the next one. A malformed line throws invalid_argument once its window is parsed, after
+// the records of the previous windows
+void ForEachCorpusRecord(std::string_view data, const std::function<void(const CorpusRecord&)>& add_record,
+                         ThreadPool* executor = nullptr);
+
+const size_t CORPUS_PROGRESS_DOCUMENT_COUNT = 100'000;
+
+// Adds every record of the file to server (SearchServer or ShardedSearchServer).
+// on_progress is called every CORPUS_PROGRESS_DOCUMENT_COUNT documents and at the end,
+// the time includes the parsing of the records added so far
+template <typename Server>
+CorpusLoadStats LoadCorpus(Server& server, const std::string& path,
+                           const std::function<void(const CorpusLoadStats&)>& on_progress = {},
+                           ThreadPool* executor = nullptr) {
+    using Clock = std::chrono::steady_clock;
+    const auto start_time = Clock::now();
+
+    const CorpusFile file(path);
+    const std::string_view data = file.GetData();
+
+    CorpusLoadStats stats;
+    ForEachCorpusRecord(data, [&](const CorpusRecord& record) {
+        server.AddDocument(record.document_id, record.text, record.status, record.ratings);
+        ++stats.document_count;
+        if (on_progress && stats.document_count % CORPUS_PROGRESS_DOCUMENT_COUNT == 0) {
+            stats.byte_count = record.text.data() + record.text.size() - data.data();
+            stats.seconds = std::chrono::duration<double>(Clock::now() - start_time).count();
+            on_progress(stats);
+        }
+    }, executor);
+
+    stats.byte_count = data.size();
+    stats.seconds = std::chrono::duration<double>(Clock::now() - start_time).count();
+    if (on_progress) {
+        on_progress(stats);
+    }
+    return stats;
+}
@@ -0,0 +1,103 @@
+#include "corpus_statistics.h"
+
+void CorpusStatistics::AddDocument(const std::map<std::string_view, double>& word_freqs, int document_length) {
+    version_ = WordWeightCache::NewVersion();
+    ++document_count_;
+    total_document_length_ += document_length;
+    AddWords(word_counts_, word_freqs);
+}
+
+void CorpusStatistics::RemoveDocument(const std::map<std::string_view, double>& word_freqs, int document_length) {
+    version_ = WordWeightCache::NewVersion();
+    --document_count_;
+    total_document_length_ -= document_length;
+    RemoveWords(word_counts_, word_freqs);
+}
+
+void CorpusStatistics::AddFieldWords(std::string_view field, const std::map<std::string_view, double>& word_freqs) {
+    version_ = WordWeightCache::NewVersion();
+    auto it = field_word_counts_.find(field);
+    if (it == field_word_counts_.end()) {
+        it = field_word_counts_.emplace(std::string(field), WordCounts{}).first;
+    }
+    AddWords(it->second, word_freqs);
+}
+
+void CorpusStatistics::RemoveFieldWords(std::string_view field, const std::map<std::string_view, double>& word_freqs) {
+    version_ = WordWeightCache::NewVersion();
+    const auto it = field_word_counts_.find(field);
+    if (it != field_word_counts_.end()) {
+        RemoveWords(it->second, word_freqs);
+    }
+}
+
+int CorpusStatistics::GetDocumentCount() const {
+    return document_count_;
+}
+
+int CorpusStatistics::GetWordDocumentCount(std::string_view word) const {
+    return GetCount(word_counts_, word);
+}
+
+int CorpusStatistics::GetFieldWordDocumentCount(std::string_view field, std::string_view word) const {
+    const auto it = field_word_counts_.find(field);
+    return it == field_word_counts_.end() ? 0 : GetCount(it->second, word);
+}
+
+uint64_t CorpusStatistics::GetVersion() const {
+    return version_;
+}
+
+double CorpusStatistics::GetAverageDocumentLength() const {
+    return document_count_ == 0 ? 0.0 : total_document_length_ * 1.0 / document_count_;
+}
+
+void CorpusStatistics::ExpandPrefix(std::string_view prefix, int max_count, std::vector<std::string_view>& words) const {
+    ExpandPrefix(word_counts_, prefix, max_count, words);
+}
+
+void CorpusStatistics::ExpandFieldPrefix(std::string_view field, std::string_view prefix, int max_count, std::vector<std::string_view>& words) const {
+    const auto it = field_word_counts_.find(field);
+    if (it != field_word_counts_.end()) {
+        ExpandPrefix(it->second, prefix, max_count, words);
+    }
+}
+
+void CorpusStatistics::AddWords(WordCounts& word_counts, const std::map<std::string_view, double>& word_freqs) {
+    for (const auto& [word, _] : word_freqs) {
+        const int term = word_counts.dictionary.Add(word);
+        if (term == static_cast<int>(word_counts.document_counts.size())) {
+            word_counts.document_counts.push_back(0);
+        }
+        ++word_counts.document_counts[term];
+    }
+}
+
+// Words stay in the dictionary with zero count, like the words of SearchServer
+void CorpusStatistics::RemoveWords(WordCounts& word_counts, const std::map<std::string_view, double>& word_freqs) {
+    for (const auto& [word, _] : word_freqs) {
+        const int term = word_counts.dictionary.Find(word);
+        if (term != TermDictionary::NO_TERM) {
+            --word_counts.document_counts[term];
+        }
+    }
+}
+
+int CorpusStatistics::GetCount(const WordCounts& word_counts, std::string_view word) {
+    const int term = word_counts.dictionary.Find(word);
+    return term == TermDictionary::NO_TERM ? 0 : word_counts.document_counts[term];
+}
+
+void CorpusStatistics::ExpandPrefix(const WordCounts& word_counts, std::string_view prefix, int max_count, std::vector<std::string_view>& words) {
+    int expansion_count = 0;
+    word_counts.dictionary.ForEachWithPrefix(prefix, [&](int term, std::string_view word) {
+        if (word_counts.document_counts[term] == 0) {
+            return true;
+        }
+        if (expansion_count++ == max_count) {
+            return false;
+        }
+        words.push_back(word);
+        return true;
+    });
+}
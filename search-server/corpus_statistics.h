@@ -0,0 +1,50 @@
+#pragma once
+
+#include "term_dictionary.h"
+#include "word_weight_cache.h"
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <string_view>
+#include <vector>
+
+class CorpusStatistics {
+public:
+    void AddDocument(const std::map<std::string_view, double>& word_freqs, int document_length);
+    void RemoveDocument(const std::map<std::string_view, double>& word_freqs, int document_length);
+    // Words of one field of a document, called along with AddDocument and RemoveDocument
+    void AddFieldWords(std::string_view field, const std::map<std::string_view, double>& word_freqs);
+    void RemoveFieldWords(std::string_view field, const std::map<std::string_view, double>& word_freqs);
+
+    int GetDocumentCount() const;
+    int GetWordDocumentCount(std::string_view word) const;
+    int GetFieldWordDocumentCount(std::string_view field, std::string_view word) const;
+    double GetAverageDocumentLength() const;
+    // Changes with every call of the modifiers above, see WordWeightCache
+    uint64_t GetVersion() const;
+
+    // Appends at most max_count words that start with prefix and occur in some document,
+    // in lexicographic order
+    void ExpandPrefix(std::string_view prefix, int max_count, std::vector<std::string_view>& words) const;
+    // The same over the words of one field
+    void ExpandFieldPrefix(std::string_view field, std::string_view prefix, int max_count, std::vector<std::string_view>& words) const;
+
+private:
+    // Number of documents with each word, indexed by term id of the dictionary
+    struct WordCounts {
+        TermDictionary dictionary;
+        std::vector<int> document_counts;
+    };
+
+    int document_count_ = 0;
+    int64_t total_document_length_ = 0;
+    uint64_t version_ = WordWeightCache::NewVersion();
+    WordCounts word_counts_;
+    std::map<std::string, WordCounts, std::less<>> field_word_counts_;
+
+    static void AddWords(WordCounts& word_counts, const std::map<std::string_view, double>& word_freqs);
+    static void RemoveWords(WordCounts& word_counts, const std::map<std::string_view, double>& word_freqs);
+    static int GetCount(const WordCounts& word_counts, std::string_view word);
+    static void ExpandPrefix(const WordCounts& word_counts, std::string_view prefix, int max_count, std::vector<std::string_view>& words);
+};
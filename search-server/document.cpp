@@ -1,5 +1,7 @@
 #include "document.h"
 
+#include <cmath>
+
 Document::Document(int id, double relevance, int rating)
     : id(id)
     , relevance(relevance)
@@ -13,3 +15,10 @@ std::ostream& operator<<(std::ostream& out, const Document& document) {
         << "rating = "s << document.rating << " }"s;
     return out;
 }
+
+bool IsMoreRelevant(const Document& lhs, const Document& rhs) {
+    if (std::abs(lhs.relevance - rhs.relevance) < RELEVANCE_EPSILON) {
+        return lhs.rating > rhs.rating;
+    }
+    return lhs.relevance > rhs.relevance;
+}
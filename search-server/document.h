@@ -4,6 +4,8 @@
 
 using namespace std::string_literals;
 
+const double RELEVANCE_EPSILON = 1e-6;
+
 struct Document {
     Document() = default;
 
@@ -22,3 +24,6 @@ enum class DocumentStatus {
 };
 
 std::ostream& operator<<(std::ostream& out, const Document& document);
+
+// Result order: by relevance, equal relevances are ordered by rating
+bool IsMoreRelevant(const Document& lhs, const Document& rhs);
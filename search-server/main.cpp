@@ -1,11 +1,19 @@
 #include "search_server.h"
+#include "sharded_search_server.h"
+#include "async_search_server.h"
 #include "process_queries.h"
+#include "corpus_loader.h"
 
 #include <iostream>
 #include <string>
 #include <vector>
 #include <execution>
 #include <random>
+#include <map>
+#include <cmath>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
 
 #define PROFILE_CONCAT_INTERNAL(X, Y) X ## Y
 #define PROFILE_CONCAT(X, Y) PROFILE_CONCAT_INTERNAL(X, Y)
@@ -81,18 +89,317 @@ vector<string> GenerateQueries(mt19937& generator, const vector<string>& diction
     return queries;
 }
 
-template <typename ExecutionPolicy>
-void Test(string_view mark, const SearchServer& search_server, const vector<string>& queries, ExecutionPolicy&& policy) {
+template <typename Ranking = TfIdfRanking, typename Server, typename ExecutionPolicy>
+void Test(string_view mark, const Server& search_server, const vector<string>& queries, ExecutionPolicy&& policy) {
     LOG_DURATION(static_cast<string>(mark));
     double total_relevance = 0;
     for (const string_view query : queries) {
-        for (const auto& document : search_server.FindTopDocuments(policy, query)) {
+        for (const auto& document : search_server.template FindTopDocuments<Ranking>(policy, query)) {
             total_relevance += document.relevance;
         }
     }
     cout << total_relevance << endl;
 }
 
+// Writes the documents as a corpus file and loads them back, the ranking must match the
+// server the documents were added to directly
+void TestLoadCorpus(ThreadPool& pool, const vector<string>& documents, const string& stop_word, const vector<string>& queries) {
+    const string path = (filesystem::temp_directory_path() / "search_server_corpus.tsv"s).string();
+    {
+        ofstream corpus(path, ios::binary);
+        for (size_t i = 0; i < documents.size(); ++i) {
+            corpus << i << "\tACTUAL\t1 2 3\t"s << documents[i] << '\n';
+        }
+    }
+    SearchServer loaded_server(stop_word);
+    const CorpusLoadStats stats = LoadCorpus(loaded_server, path, {}, &pool);
+    remove(path.c_str());
+    cerr << "load corpus: "s << stats << endl;
+    Test("loaded corpus seq"s, loaded_server, queries, execution::seq);
+}
+
+// Every thread adds to key_count keys: few keys means high contention. With one thread
+// there is no contention at all and only the cost of a single addition is compared
+void TestConcurrentMap(ThreadPool& pool, int key_count) {
+    const int operation_count = 10'000'000;
+    const string mark = to_string(key_count) + " keys, "s + to_string(pool.GetThreadCount()) + " threads"s;
+    {
+        LOG_DURATION("ConcurrentMap, "s + mark);
+        ConcurrentMap<int, double> concurrent_map(key_count);
+        pool.ParallelFor(0, operation_count, [&](size_t i) { concurrent_map.Add(i % key_count, 1.0); });
+    }
+    {
+        LOG_DURATION("mutex and std::map, "s + mark);
+        mutex map_mutex;
+        map<int, double> ordinary_map;
+        pool.ParallelFor(0, operation_count, [&](size_t i) {
+            lock_guard guard(map_mutex);
+            ordinary_map[i % key_count] += 1.0;
+        });
+    }
+}
+
+// Documents with the same words differ only in how far the plus word is from the phrase:
+// the closer one must rank higher, and a phrase alone must not be boosted
+void TestProximity() {
+    SearchServer search_server("and"s);
+    search_server.EnablePositionalIndex();
+    search_server.AddDocument(1, "white cat and a dog x y z w v"sv, DocumentStatus::ACTUAL, {1});
+    search_server.AddDocument(2, "white cat and x y z w v a dog"sv, DocumentStatus::ACTUAL, {1});
+    search_server.AddDocument(3, "black dog"sv, DocumentStatus::ACTUAL, {1});
+    const auto documents = search_server.FindTopDocuments("\"white cat\" dog"sv);
+    if (documents.size() != 2 || documents[0].id != 1 || !(documents[0].relevance > documents[1].relevance + RELEVANCE_EPSILON)) {
+        throw logic_error("Closer query terms do not rank higher"s);
+    }
+    const auto phrase_documents = search_server.FindTopDocuments("\"white cat\""sv);
+    if (phrase_documents.size() != 2 || abs(phrase_documents[0].relevance - phrase_documents[1].relevance) >= RELEVANCE_EPSILON) {
+        throw logic_error("A phrase alone changes the ranking"s);
+    }
+    cout << "proximity: "s << documents[0].relevance << " vs "s << documents[1].relevance << endl;
+}
+
+// Ids of all documents in the pages of page_size that find_page(page_size, after) returns one by one
+template <typename PageFinder>
+vector<int> CollectPages(PageFinder find_page, size_t page_size, size_t max_document_count) {
+    vector<int> ids;
+    optional<SearchCursor> after;
+    do {
+        const DocumentPage page = find_page(page_size, after);
+        for (const Document& document : page.documents) {
+            ids.push_back(document.id);
+        }
+        if (ids.size() > max_document_count) {
+            throw logic_error("Pages repeat documents"s);
+        }
+        after = page.next;
+    } while (after);
+    return ids;
+}
+
+// The pages of every size must give the full ranking, each document once and in order
+template <typename PageFinder>
+void CheckPages(string_view mark, PageFinder find_page, size_t document_count, const vector<size_t>& page_sizes) {
+    const auto expected = CollectPages(find_page, max<size_t>(document_count, 1), document_count);
+    for (const size_t page_size : page_sizes) {
+        if (CollectPages(find_page, page_size, document_count) != expected) {
+            throw logic_error("Pages of "s + to_string(page_size) + " differ from the full ranking: "s + string(mark));
+        }
+    }
+}
+
+template <typename Server>
+void TestDocumentsPages(string_view mark, const Server& search_server, const vector<string>& queries) {
+    for (const string& query : queries) {
+        CheckPages(mark, [&](size_t page_size, const optional<SearchCursor>& after) {
+            return search_server.FindDocumentsPage(query, DocumentStatus::ACTUAL, page_size, after);
+        }, search_server.GetDocumentCount(), {10, 37, 100});
+    }
+    // Neighbours closer than RELEVANCE_EPSILON form a chain with the first and the last apart
+    const vector<Document> chain = {{1, 0.000890045, 10}, {2, 0.000890853, 5}, {3, 0.000891663, 0}};
+    CheckPages(mark, [&](size_t page_size, const optional<SearchCursor>& after) {
+        return MakeDocumentPage(chain, page_size, after);
+    }, chain.size(), {1, 2});
+    cout << "pages, "s << mark << ": ok"s << endl;
+}
+
+// Compares the top documents of the two servers, throws if they differ by more than RELEVANCE_EPSILON
+template <typename Ranking, typename ExecutionPolicy>
+double CompareQuantizedRanking(string_view mark, const SearchServer& search_server, const SearchServer& quantized_server,
+                               const vector<string>& queries, ExecutionPolicy&& policy) {
+    double total_relevance = 0;
+    double max_difference = 0;
+    for (const string& query : queries) {
+        const auto expected = search_server.FindTopDocuments<Ranking>(policy, query);
+        const auto actual = quantized_server.FindTopDocuments<Ranking>(policy, query);
+        if (expected.size() != actual.size()) {
+            throw logic_error("Quantized "s + string(mark) + " finds another number of documents for "s + query);
+        }
+        for (size_t i = 0; i < expected.size(); ++i) {
+            const double difference = abs(expected[i].relevance - actual[i].relevance);
+            if (expected[i].id != actual[i].id || difference >= RELEVANCE_EPSILON) {
+                throw logic_error("Quantized "s + string(mark) + " ranks differently for "s + query);
+            }
+            max_difference = max(max_difference, difference);
+            total_relevance += expected[i].relevance;
+        }
+    }
+    if (!(total_relevance > 0)) {
+        throw logic_error("Quantized "s + string(mark) + " test corpus has no relevant documents"s);
+    }
+    return max_difference;
+}
+
+// Quantized term frequencies must rank as the double postings do, also after removed documents
+// are added again on their old ordinals. Every document repeats document_word_count words of the
+// dictionary, so long documents push word counts past 8 bits while each word stays out of most
+// documents and has a nonzero IDF
+void TestQuantizedTermFrequencies(mt19937& generator, int document_count, int document_length, int document_word_count) {
+    const auto dictionary = GenerateDictionary(generator, 1000, 10);
+    vector<string> documents;
+    documents.reserve(document_count);
+    for (int i = 0; i < document_count; ++i) {
+        vector<string> document_words;
+        for (int j = 0; j < document_word_count; ++j) {
+            document_words.push_back(dictionary[uniform_int_distribution<int>(0, dictionary.size() - 1)(generator)]);
+        }
+        documents.push_back(GenerateQuery(generator, document_words, document_length));
+    }
+    const auto queries = GenerateQueries(generator, dictionary, 100, 10);
+
+    SearchServer search_server(dictionary[0]);
+    SearchServer quantized_server(dictionary[0]);
+    quantized_server.EnableQuantizedTermFrequencies();
+    const auto add_document = [&](int document_id) {
+        search_server.AddDocument(document_id, documents[document_id], DocumentStatus::ACTUAL, {document_id % 7});
+        quantized_server.AddDocument(document_id, documents[document_id], DocumentStatus::ACTUAL, {document_id % 7});
+    };
+    const auto compare = [&] {
+        return max({CompareQuantizedRanking<TfIdfRanking>("tf-idf seq"s, search_server, quantized_server, queries, execution::seq),
+                    CompareQuantizedRanking<TfIdfRanking>("tf-idf par"s, search_server, quantized_server, queries, execution::par),
+                    CompareQuantizedRanking<Bm25Ranking>("bm25 seq"s, search_server, quantized_server, queries, execution::seq)});
+    };
+
+    for (int i = 0; i < document_count; ++i) {
+        add_document(i);
+    }
+    double max_difference = compare();
+    for (int i = 0; i < document_count; i += 3) {
+        search_server.RemoveDocument(i);
+        quantized_server.RemoveDocument(i);
+    }
+    max_difference = max(max_difference, compare());
+    for (int i = 0; i < document_count; i += 3) {
+        add_document(i);
+    }
+    max_difference = max(max_difference, compare());
+
+    cout << "quantized tf, "s << document_count << " documents of "s << document_length << " words: "s
+         << "max relevance difference "s << max_difference << endl;
+}
+
+// Submitted queries must rank as the server does. With one query per batch, the queries
+// queued behind the others that are cancelled or expired must fail as soon as the next
+// window opens, before the queries ahead of them are executed
+void TestAsyncSearchServer(const SearchServer& search_server, const vector<string>& queries) {
+    AsyncSearchServer async_server(search_server, chrono::microseconds(50), 1);
+    vector<AsyncSearchServer::PendingQuery> pending;
+    for (const string& query : queries) {
+        pending.push_back(async_server.SubmitFindTopDocuments(query));
+    }
+    auto cancelled = async_server.SubmitFindTopDocuments(queries.front());
+    cancelled.Cancel();
+    auto expired = async_server.SubmitFindTopDocuments(queries.front(), DocumentStatus::ACTUAL, AsyncSearchServer::Clock::now());
+
+    try {
+        cancelled.result.get();
+        throw logic_error("Cancelled query is executed"s);
+    } catch (const QueryCancelledError&) {
+    }
+    try {
+        expired.result.get();
+        throw logic_error("Expired query is executed"s);
+    } catch (const QueryDeadlineError&) {
+    }
+    if (pending.back().result.wait_for(chrono::seconds(0)) == future_status::ready) {
+        throw logic_error("Cancelled and expired queries wait for the queries ahead of them"s);
+    }
+
+    for (size_t i = 0; i < queries.size(); ++i) {
+        const auto documents = pending[i].result.get();
+        const auto expected = search_server.FindTopDocuments(queries[i]);
+        if (documents.size() != expected.size()) {
+            throw logic_error("Async query finds another number of documents: "s + queries[i]);
+        }
+        for (size_t j = 0; j < documents.size(); ++j) {
+            if (documents[j].id != expected[j].id || documents[j].relevance != expected[j].relevance) {
+                throw logic_error("Async query ranks differently: "s + queries[i]);
+            }
+        }
+    }
+    cout << "async: "s << queries.size() << " queries ok, cancelled and expired failed ahead of them"s << endl;
+}
+
+// The ranking formulas written out by hand, the reference that the ranking policies of
+// SearchServer are compared against. The index is built the way AddDocument builds it:
+// postings of term frequencies inserted along with the forward index of each document, so
+// both loops walk the same map nodes laid out the same way in memory. Like FindTopDocuments,
+// it keeps only ACTUAL documents and selects the top by relevance
+template <bool IS_BM25>
+void TestHandWrittenLoop(string_view mark, const vector<string>& documents, const string& stop_word, const vector<string>& queries) {
+    map<string, map<int, double>, less<>> word_to_document_freqs;
+    vector<map<string_view, double>> document_to_word_freqs(documents.size());
+    vector<int> document_lengths(documents.size());
+    const vector<DocumentStatus> document_statuses(documents.size(), DocumentStatus::ACTUAL);
+    int64_t total_length = 0;
+    for (size_t i = 0; i < documents.size(); ++i) {
+        vector<string_view> words;
+        for (const string_view word : SplitIntoWordsView(documents[i])) {
+            if (word != stop_word) {
+                words.push_back(word);
+            }
+        }
+        document_lengths[i] = words.size();
+        total_length += words.size();
+        const double inv_word_count = 1.0 / words.size();
+        for (const string_view word : words) {
+            auto it = word_to_document_freqs.find(word);
+            if (it == word_to_document_freqs.end()) {
+                it = word_to_document_freqs.emplace(string(word), map<int, double>{}).first;
+            }
+            it->second[i] += inv_word_count;
+            document_to_word_freqs[i][it->first] += inv_word_count;
+        }
+    }
+    const double document_count = documents.size();
+    const double average_length = total_length / document_count;
+
+    LOG_DURATION(static_cast<string>(mark));
+    double total_relevance = 0;
+    vector<double> relevance(documents.size());
+    vector<int> matched;
+    for (const string& query : queries) {
+        auto words = SplitIntoWordsView(query);
+        sort(words.begin(), words.end());
+        words.erase(unique(words.begin(), words.end()), words.end());
+        for (const string_view word : words) {
+            const auto it = word_to_document_freqs.find(word);
+            if (word == stop_word || it == word_to_document_freqs.end()) {
+                continue;
+            }
+            const double word_document_count = it->second.size();
+            const double idf = IS_BM25 ? log((document_count - word_document_count + 0.5) / (word_document_count + 0.5) + 1.0)
+                                       : log(document_count / word_document_count);
+            for (const auto [document, term_freq] : it->second) {
+                if (document_statuses[document] != DocumentStatus::ACTUAL) {
+                    continue;
+                }
+                if (relevance[document] == 0.0) {
+                    matched.push_back(document);
+                }
+                if constexpr (IS_BM25) {
+                    const double count = term_freq * document_lengths[document];
+                    const double length_norm = 1.0 - Bm25Ranking::B + Bm25Ranking::B * document_lengths[document] / average_length;
+                    relevance[document] += idf * count * (Bm25Ranking::K1 + 1.0) / (count + Bm25Ranking::K1 * length_norm);
+                } else {
+                    relevance[document] += term_freq * idf;
+                }
+            }
+        }
+        const size_t top_count = min<size_t>(MAX_RESULT_DOCUMENT_COUNT, matched.size());
+        partial_sort(matched.begin(), matched.begin() + top_count, matched.end(), [&](int lhs, int rhs) {
+            return relevance[lhs] > relevance[rhs];
+        });
+        for (size_t i = 0; i < top_count; ++i) {
+            total_relevance += relevance[matched[i]];
+        }
+        for (const int document : matched) {
+            relevance[document] = 0.0;
+        }
+        matched.clear();
+    }
+    cout << total_relevance << endl;
+}
+
 #define TEST(policy) Test(#policy, search_server, queries, execution::policy)
 
 int main() {
@@ -110,4 +417,47 @@ int main() {
 
     TEST(seq);
     TEST(par);
+    Test<Bm25Ranking>("bm25 seq"s, search_server, queries, execution::seq);
+    Test<Bm25Ranking>("bm25 par"s, search_server, queries, execution::par);
+    TestHandWrittenLoop<false>("hand-written tf-idf"s, documents, dictionary[0], queries);
+    TestHandWrittenLoop<true>("hand-written bm25"s, documents, dictionary[0], queries);
+
+    SearchServer quantized_server(dictionary[0]);
+    quantized_server.EnableQuantizedTermFrequencies();
+    for (size_t i = 0; i < documents.size(); ++i) {
+        quantized_server.AddDocument(i, documents[i], DocumentStatus::ACTUAL, {1, 2, 3});
+    }
+    Test("quantized seq"s, quantized_server, queries, execution::seq);
+
+    SearchServer positional_server(dictionary[0]);
+    positional_server.EnablePositionalIndex();
+    for (size_t i = 0; i < documents.size(); ++i) {
+        positional_server.AddDocument(i, documents[i], DocumentStatus::ACTUAL, {1, 2, 3});
+    }
+    Test("positional seq"s, positional_server, queries, execution::seq);
+    TestProximity();
+    TestQuantizedTermFrequencies(generator, 10'000, 70, 70);
+    TestQuantizedTermFrequencies(generator, 200, 5'000, 10);
+
+    ThreadPool pool(thread::hardware_concurrency());
+    search_server.SetExecutor(&pool);
+    Test("par on thread pool"s, search_server, queries, execution::par);
+    search_server.SetExecutor(nullptr);
+    TestLoadCorpus(pool, documents, dictionary[0], queries);
+
+    TestConcurrentMap(pool, 16);
+    TestConcurrentMap(pool, 10'000);
+
+    ShardedSearchServer sharded_server(dictionary[0], 4);
+    for (size_t i = 0; i < documents.size(); ++i) {
+        sharded_server.AddDocument(i, documents[i], DocumentStatus::ACTUAL, {1, 2, 3});
+    }
+
+    Test("sharded par"s, sharded_server, queries, execution::par);
+
+    const auto page_queries = GenerateQueries(generator, dictionary, 10, 3);
+    TestDocumentsPages("single"s, search_server, page_queries);
+    TestDocumentsPages("sharded"s, sharded_server, page_queries);
+
+    TestAsyncSearchServer(search_server, queries);
 }
@@ -0,0 +1,41 @@
+#include "paginator.h"
+
+#include <algorithm>
+
+bool IsRankedAfter(const Document& document, const SearchCursor& cursor) {
+    return IsRankedBefore({cursor.id, cursor.relevance, cursor.rating}, document);
+}
+
+DocumentPage MakeDocumentPage(const std::vector<Document>& documents, size_t page_size, const std::optional<SearchCursor>& after) {
+    if (page_size == 0) {
+        throw std::invalid_argument("Invalid page size"s);
+    }
+
+    // Max-heap by rank keeps the page_size + 1 best documents, the extra one tells
+    // whether there is a next page
+    std::vector<Document> heap;
+    heap.reserve(page_size + 1);
+    for (const Document& document : documents) {
+        if (after && !IsRankedAfter(document, *after)) {
+            continue;
+        }
+        if (heap.size() <= page_size) {
+            heap.push_back(document);
+            std::push_heap(heap.begin(), heap.end(), IsRankedBefore);
+        } else if (IsRankedBefore(document, heap.front())) {
+            std::pop_heap(heap.begin(), heap.end(), IsRankedBefore);
+            heap.back() = document;
+            std::push_heap(heap.begin(), heap.end(), IsRankedBefore);
+        }
+    }
+    std::sort_heap(heap.begin(), heap.end(), IsRankedBefore);
+
+    DocumentPage page;
+    if (heap.size() > page_size) {
+        heap.pop_back();
+        const Document& last = heap.back();
+        page.next = SearchCursor{last.relevance, last.rating, last.id};
+    }
+    page.documents = std::move(heap);
+    return page;
+}
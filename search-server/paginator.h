@@ -4,6 +4,8 @@
 #include <iostream>
 #include <vector>
 #include <cmath>
+#include <cstdint>
+#include <optional>
 
 template <typename Iterator>
 class IteratorRange {
@@ -75,3 +77,46 @@ template <typename Container>
 auto Paginate(const Container& c, size_t page_size) {
     return Paginator(begin(c), end(c), page_size);
 }
+
+// Search-after pagination: a page of the ranked results and the position after its
+// last document. Passing the cursor back resumes the ranking right after that document
+struct SearchCursor {
+    double relevance = 0.0;
+    int rating = 0;
+    int id = 0;
+};
+
+struct DocumentPage {
+    std::vector<Document> documents;
+    std::optional<SearchCursor> next;  // Empty on the last page
+};
+
+// Strict total order of ranked results: relevance rounded to RELEVANCE_EPSILON steps,
+// then rating, then ascending id. Both servers rank, merge and page with it.
+// Inline, as top selection calls it once per matched document
+inline bool IsRankedBefore(const Document& lhs, const Document& rhs) {
+    // Relevances more than a step apart are in different steps, so rounding is needed only
+    // for close ones. Unlike the epsilon test of IsMoreRelevant, which chains
+    // 0.0000010 ~ 0.0000018 ~ 0.0000026, the steps are fixed
+    if (lhs.relevance - rhs.relevance > RELEVANCE_EPSILON) {
+        return true;
+    }
+    if (rhs.relevance - lhs.relevance > RELEVANCE_EPSILON) {
+        return false;
+    }
+    const int64_t lhs_step = std::llround(lhs.relevance / RELEVANCE_EPSILON);
+    const int64_t rhs_step = std::llround(rhs.relevance / RELEVANCE_EPSILON);
+    if (lhs_step != rhs_step) {
+        return lhs_step > rhs_step;
+    }
+    if (lhs.rating != rhs.rating) {
+        return lhs.rating > rhs.rating;
+    }
+    return lhs.id < rhs.id;
+}
+
+bool IsRankedAfter(const Document& document, const SearchCursor& cursor);
+
+// Selects the first page_size documents after the cursor with a bounded heap:
+// O(documents * log(page_size)) instead of sorting all of them
+DocumentPage MakeDocumentPage(const std::vector<Document>& documents, size_t page_size, const std::optional<SearchCursor>& after);
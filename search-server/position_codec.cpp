@@ -0,0 +1,37 @@
+#include "position_codec.h"
+
+std::vector<uint8_t> CompressPositions(const std::vector<int>& positions) {
+    std::vector<uint8_t> data;
+    data.reserve(positions.size());
+    int previous = 0;
+    for (const int position : positions) {
+        uint32_t delta = position - previous;
+        previous = position;
+        while (delta >= 0x80) {
+            data.push_back(static_cast<uint8_t>(delta | 0x80));
+            delta >>= 7;
+        }
+        data.push_back(static_cast<uint8_t>(delta));
+    }
+    return data;
+}
+
+std::vector<int> DecompressPositions(const std::vector<uint8_t>& data) {
+    std::vector<int> positions;
+    positions.reserve(data.size());
+    int previous = 0;
+    uint32_t delta = 0;
+    int shift = 0;
+    for (const uint8_t byte : data) {
+        delta |= static_cast<uint32_t>(byte & 0x7F) << shift;
+        if (byte & 0x80) {
+            shift += 7;
+            continue;
+        }
+        previous += delta;
+        positions.push_back(previous);
+        delta = 0;
+        shift = 0;
+    }
+    return positions;
+}
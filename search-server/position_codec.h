@@ -0,0 +1,9 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+// Word positions of one word in one document: ascending positions are stored
+// as varint-encoded deltas, which takes one byte for most gaps
+std::vector<uint8_t> CompressPositions(const std::vector<int>& positions);
+std::vector<int> DecompressPositions(const std::vector<uint8_t>& data);
@@ -3,6 +3,11 @@
 std::vector<std::vector<Document>> ProcessQueries(const SearchServer& search_server, const std::vector<std::string>& queries) {
     std::vector<std::vector<Document>> result(queries.size());
 
+    if (ThreadPool* executor = search_server.GetExecutor()) {
+        executor->ParallelFor(0, queries.size(), [&](size_t i) { result[i] = search_server.FindTopDocuments(queries[i]); });
+        return result;
+    }
+
     std::transform(
         std::execution::par,
         queries.begin(), queries.end(), result.begin(),
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <cmath>
+
+// Ranking policies for SearchServer::FindTopDocuments<Ranking>.
+// ComputeWordWeight is called once per query word, ComputeScore once per posting;
+// both are static so the scoring loop is inlined for each policy.
+// term_freq is the share of the word among document words (stop words excluded)
+
+struct TfIdfRanking {
+    static double ComputeWordWeight(int document_count, int word_document_count) {
+        return std::log(document_count * 1.0 / word_document_count);
+    }
+
+    static double ComputeScore(double term_freq, int /*document_length*/, double /*average_document_length*/, double word_weight) {
+        return term_freq * word_weight;
+    }
+};
+
+struct Bm25Ranking {
+    static constexpr double K1 = 1.2;
+    static constexpr double B = 0.75;
+
+    static double ComputeWordWeight(int document_count, int word_document_count) {
+        return std::log((document_count - word_document_count + 0.5) / (word_document_count + 0.5) + 1.0);
+    }
+
+    static double ComputeScore(double term_freq, int document_length, double average_document_length, double word_weight) {
+        const double word_count = term_freq * document_length;
+        const double length_norm = 1.0 - B + B * document_length / average_document_length;
+        return word_weight * word_count * (K1 + 1.0) / (word_count + K1 * length_norm);
+    }
+};
@@ -0,0 +1,190 @@
+#include "scoring_kernels.h"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+using namespace std::string_literals;
+
+namespace {
+
+#if defined(__AVX2__)
+
+__m128i LoadWordCounts(const uint8_t* word_counts) {
+    int32_t packed;
+    std::memcpy(&packed, word_counts, sizeof(packed));
+    return _mm_cvtepu8_epi32(_mm_cvtsi32_si128(packed));
+}
+
+__m128i LoadWordCounts(const uint16_t* word_counts) {
+    int64_t packed;
+    std::memcpy(&packed, word_counts, sizeof(packed));
+    return _mm_cvtepu16_epi32(_mm_cvtsi64_si128(packed));
+}
+
+// Four postings per step: counts are widened to doubles, inverse lengths are gathered by
+// ordinal, the products are scattered back one by one since AVX2 has no scatter
+template <typename Count>
+size_t AccumulateBlocks(const int* ordinals, const Count* word_counts, size_t size,
+                        const double* inverse_lengths, double word_weight, double* scores) {
+    const __m256d weight = _mm256_set1_pd(word_weight);
+    const __m256d all_lanes = _mm256_castsi256_pd(_mm256_set1_epi64x(-1));
+    alignas(32) double term_scores[4];
+    size_t i = 0;
+    for (; i + 4 <= size; i += 4) {
+        const __m128i index = _mm_loadu_si128(reinterpret_cast<const __m128i*>(ordinals + i));
+        const __m256d inverse_length = _mm256_mask_i32gather_pd(
+            _mm256_setzero_pd(), inverse_lengths, index, all_lanes, sizeof(double));
+        const __m256d count = _mm256_cvtepi32_pd(LoadWordCounts(word_counts + i));
+        _mm256_store_pd(term_scores, _mm256_mul_pd(_mm256_mul_pd(count, inverse_length), weight));
+        for (int j = 0; j < 4; ++j) {
+            scores[ordinals[i + j]] += term_scores[j];
+        }
+    }
+    return i;
+}
+
+#elif defined(__SSE2__)
+
+// Two postings per step, SSE2 has no gather so the lanes are loaded separately
+template <typename Count>
+size_t AccumulateBlocks(const int* ordinals, const Count* word_counts, size_t size,
+                        const double* inverse_lengths, double word_weight, double* scores) {
+    const __m128d weight = _mm_set1_pd(word_weight);
+    alignas(16) double term_scores[2];
+    size_t i = 0;
+    for (; i + 2 <= size; i += 2) {
+        const __m128d inverse_length = _mm_set_pd(inverse_lengths[ordinals[i + 1]], inverse_lengths[ordinals[i]]);
+        const __m128d count = _mm_set_pd(word_counts[i + 1], word_counts[i]);
+        _mm_store_pd(term_scores, _mm_mul_pd(_mm_mul_pd(count, inverse_length), weight));
+        scores[ordinals[i]] += term_scores[0];
+        scores[ordinals[i + 1]] += term_scores[1];
+    }
+    return i;
+}
+
+#else
+
+template <typename Count>
+size_t AccumulateBlocks(const int*, const Count*, size_t, const double*, double, double*) {
+    return 0;
+}
+
+#endif
+
+template <typename Count>
+void AccumulateTermScoresImpl(const int* ordinals, const Count* word_counts, size_t size,
+                              const double* inverse_lengths, double word_weight, double* scores) {
+    for (size_t i = AccumulateBlocks(ordinals, word_counts, size, inverse_lengths, word_weight, scores); i < size; ++i) {
+        scores[ordinals[i]] += word_counts[i] * inverse_lengths[ordinals[i]] * word_weight;
+    }
+}
+
+} // namespace
+
+void AccumulateTermScores(const int* ordinals, const uint8_t* word_counts, size_t size,
+                          const double* inverse_lengths, double word_weight, double* scores) {
+    AccumulateTermScoresImpl(ordinals, word_counts, size, inverse_lengths, word_weight, scores);
+}
+
+void AccumulateTermScores(const int* ordinals, const uint16_t* word_counts, size_t size,
+                          const double* inverse_lengths, double word_weight, double* scores) {
+    AccumulateTermScoresImpl(ordinals, word_counts, size, inverse_lengths, word_weight, scores);
+}
+
+void QuantizedPostings::Add(int ordinal, int word_count) {
+    if (word_count <= 0 || word_count > MAX_WORD_COUNT) {
+        throw std::out_of_range("Word count does not fit quantized postings"s);
+    }
+    if (!is_wide_ && word_count > UINT8_MAX) {
+        counts16_.assign(counts8_.begin(), counts8_.end());
+        counts8_.clear();
+        counts8_.shrink_to_fit();
+        is_wide_ = true;
+    }
+    // New ordinals come last, only reused ones go in between
+    const auto it = ordinals_.empty() || ordinals_.back() < ordinal
+        ? ordinals_.end()
+        : std::lower_bound(ordinals_.begin(), ordinals_.end(), ordinal);
+    const size_t index = it - ordinals_.begin();
+    if (it != ordinals_.end() && *it == ordinal) {
+        if (GetCount(index) == 0) {
+            --removed_count_;
+        }
+        SetCount(index, word_count);
+        return;
+    }
+    ordinals_.insert(it, ordinal);
+    if (is_wide_) {
+        counts16_.insert(counts16_.begin() + index, static_cast<uint16_t>(word_count));
+    } else {
+        counts8_.insert(counts8_.begin() + index, static_cast<uint8_t>(word_count));
+    }
+}
+
+void QuantizedPostings::Remove(int ordinal) {
+    const auto it = std::lower_bound(ordinals_.begin(), ordinals_.end(), ordinal);
+    if (it == ordinals_.end() || *it != ordinal || GetCount(it - ordinals_.begin()) == 0) {
+        return;
+    }
+    SetCount(it - ordinals_.begin(), 0);
+    if (++removed_count_ * 2 > ordinals_.size()) {
+        Compact();
+    }
+}
+
+bool QuantizedPostings::Contains(int ordinal) const {
+    const auto it = std::lower_bound(ordinals_.begin(), ordinals_.end(), ordinal);
+    return it != ordinals_.end() && *it == ordinal && GetCount(it - ordinals_.begin()) > 0;
+}
+
+size_t QuantizedPostings::size() const {
+    return ordinals_.size() - removed_count_;
+}
+
+bool QuantizedPostings::empty() const {
+    return size() == 0;
+}
+
+int QuantizedPostings::GetCount(size_t index) const {
+    return is_wide_ ? counts16_[index] : counts8_[index];
+}
+
+void QuantizedPostings::SetCount(size_t index, int word_count) {
+    if (is_wide_) {
+        counts16_[index] = static_cast<uint16_t>(word_count);
+    } else {
+        counts8_[index] = static_cast<uint8_t>(word_count);
+    }
+}
+
+void QuantizedPostings::Compact() {
+    size_t size = 0;
+    for (size_t i = 0; i < ordinals_.size(); ++i) {
+        const int word_count = GetCount(i);
+        if (word_count > 0) {
+            ordinals_[size] = ordinals_[i];
+            SetCount(size++, word_count);
+        }
+    }
+    ordinals_.resize(size);
+    if (is_wide_) {
+        counts16_.resize(size);
+    } else {
+        counts8_.resize(size);
+    }
+    removed_count_ = 0;
+}
+
+void QuantizedPostings::AccumulateScores(const double* inverse_lengths, double word_weight, double* scores) const {
+    if (is_wide_) {
+        AccumulateTermScores(ordinals_.data(), counts16_.data(), ordinals_.size(), inverse_lengths, word_weight, scores);
+    } else {
+        AccumulateTermScores(ordinals_.data(), counts8_.data(), ordinals_.size(), inverse_lengths, word_weight, scores);
+    }
+}
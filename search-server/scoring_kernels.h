@@ -0,0 +1,65 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// scores[ordinals[i]] += word_counts[i] * inverse_lengths[ordinals[i]] * word_weight.
+// Uses AVX2 (gathers four inverse lengths at once) or SSE2 when the compiler targets them,
+// a scalar loop otherwise; all variants multiply in the same order and give equal results
+void AccumulateTermScores(const int* ordinals, const uint8_t* word_counts, size_t size,
+                          const double* inverse_lengths, double word_weight, double* scores);
+void AccumulateTermScores(const int* ordinals, const uint16_t* word_counts, size_t size,
+                          const double* inverse_lengths, double word_weight, double* scores);
+
+// Postings of one word: document ordinals and the number of times the word occurs in each.
+// Counts are kept in 8 bits and the block is widened to 16 bits once a count does not fit.
+// Term frequency of a posting is its count times the inverse document length.
+// Ordinals are sorted, so lookups are binary searches. A removed posting keeps its place
+// with count 0, which adds nothing to scores, until removed postings make up half of the
+// block and it is compacted; a removed ordinal that comes back takes its old place
+class QuantizedPostings {
+public:
+    static constexpr int MAX_WORD_COUNT = UINT16_MAX;
+
+    void Add(int ordinal, int word_count);
+    void Remove(int ordinal);
+    bool Contains(int ordinal) const;
+
+    // Number of postings that are not removed
+    size_t size() const;
+    bool empty() const;
+
+    // Calls function(ordinal, word_count) for the postings that are not removed, in ordinal order
+    template <typename Function>
+    void ForEach(Function function) const;
+
+    void AccumulateScores(const double* inverse_lengths, double word_weight, double* scores) const;
+
+private:
+    std::vector<int> ordinals_;
+    std::vector<uint8_t> counts8_;
+    std::vector<uint16_t> counts16_;
+    bool is_wide_ = false;
+    size_t removed_count_ = 0;
+
+    int GetCount(size_t index) const;
+    void SetCount(size_t index, int word_count);
+    void Compact();
+};
+
+template <typename Function>
+void QuantizedPostings::ForEach(Function function) const {
+    const auto for_each = [&](const auto& counts) {
+        for (size_t i = 0; i < ordinals_.size(); ++i) {
+            if (counts[i] > 0) {
+                function(ordinals_[i], static_cast<int>(counts[i]));
+            }
+        }
+    };
+    if (is_wide_) {
+        for_each(counts16_);
+    } else {
+        for_each(counts8_);
+    }
+}
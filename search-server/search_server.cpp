@@ -1,5 +1,13 @@
 #include "search_server.h"
 
+size_t DocumentMatches::size() const {
+    return statuses.size();
+}
+
+IteratorRange<std::vector<std::string_view>::const_iterator> DocumentMatches::GetWords(size_t index) const {
+    return {words.begin() + offsets.at(index), words.begin() + offsets.at(index + 1)};
+}
+
 SearchServer::SearchServer(std::string_view stop_words_text)
     : SearchServer(SplitIntoWordsView(stop_words_text)) {
 }
@@ -8,19 +16,145 @@ SearchServer::SearchServer(const std::string& stop_words_text)
     : SearchServer(std::string_view(stop_words_text)) {
 }
 
+void SearchServer::EnablePositionalIndex() {
+    if (!document_id_to_ordinal_.empty()) {
+        throw std::logic_error("Positional index must be enabled before adding documents"s);
+    }
+    has_positions_ = true;
+    document_to_word_positions_.resize(GetOrdinalCount());
+}
+
+void SearchServer::EnableQuantizedTermFrequencies() {
+    if (!document_id_to_ordinal_.empty()) {
+        throw std::logic_error("Quantized term frequencies must be enabled before adding documents"s);
+    }
+    if (std::any_of(field_weights_.begin(), field_weights_.end(), [](double weight) { return weight != 1.0; })) {
+        throw std::logic_error("Quantized term frequencies do not support weighted fields"s);
+    }
+    has_quantized_term_freqs_ = true;
+    inverse_document_lengths_.resize(GetOrdinalCount());
+}
+
+void SearchServer::AddField(std::string_view name, double weight) {
+    if (!document_id_to_ordinal_.empty()) {
+        throw std::logic_error("Fields must be added before adding documents"s);
+    }
+    if (name.empty() || name.find_first_of(" :") != std::string_view::npos || !IsValidWord(name) || field_ids_.count(name) > 0) {
+        throw std::invalid_argument("Invalid field name"s);
+    }
+    if (!(weight > 0.0)) {
+        throw std::invalid_argument("Field weight must be positive"s);
+    }
+    if (has_quantized_term_freqs_ && weight != 1.0) {
+        throw std::logic_error("Quantized term frequencies do not support weighted fields"s);
+    }
+    const auto [it, _] = field_ids_.emplace(std::string(name), static_cast<int>(field_names_.size()));
+    field_names_.push_back(it->first);
+    field_weights_.push_back(weight);
+    field_word_to_document_freqs_.emplace_back();
+    document_to_field_word_freqs_.resize(GetOrdinalCount());
+}
+
 void SearchServer::AddDocument(int document_id, std::string_view document, DocumentStatus status, const std::vector<int>& ratings) {
-    if ((document_id < 0) || (documents_.count(document_id) > 0)) {
+    const auto words = SplitIntoWordsNoStop(document);
+    AddDocumentWords(document_id, words, std::vector<int>(words.size(), NO_FIELD), status, ratings);
+}
+
+void SearchServer::AddDocument(int document_id, const std::vector<DocumentField>& fields, DocumentStatus status, const std::vector<int>& ratings) {
+    std::vector<std::string_view> words;
+    std::vector<int> word_fields;
+    for (const auto& [name, text] : fields) {
+        const auto it = field_ids_.find(name);
+        if (it == field_ids_.end()) {
+            throw std::invalid_argument("Unknown document field"s);
+        }
+        for (const std::string_view word : SplitIntoWordsNoStop(text)) {
+            words.push_back(word);
+            word_fields.push_back(it->second);
+        }
+    }
+    AddDocumentWords(document_id, words, word_fields, status, ratings);
+}
+
+void SearchServer::AddDocumentWords(int document_id, const std::vector<std::string_view>& words, const std::vector<int>& word_fields,
+                                    DocumentStatus status, const std::vector<int>& ratings) {
+    if ((document_id < 0) || (document_id_to_ordinal_.count(document_id) > 0)) {
         throw std::invalid_argument("Invalid document_id"s);
     }
-    documents_.emplace(document_id, DocumentData{ComputeAverageRating(ratings), status});
+    std::map<std::string_view, int> word_counts;
+    if (has_quantized_term_freqs_) {
+        for (const std::string_view word : words) {
+            if (++word_counts[word] > QuantizedPostings::MAX_WORD_COUNT) {
+                throw std::invalid_argument("Word occurs too many times for quantized term frequencies"s);
+            }
+        }
+    }
 
-    const auto words = SplitIntoWordsNoStop(document);
+    int ordinal = GetOrdinalCount();
+    if (free_ordinals_.empty()) {
+        documents_.emplace_back();
+        document_to_word_freqs_.emplace_back();
+        if (has_positions_) {
+            document_to_word_positions_.emplace_back();
+        }
+        if (has_quantized_term_freqs_) {
+            inverse_document_lengths_.emplace_back();
+        }
+        if (!field_names_.empty()) {
+            document_to_field_word_freqs_.emplace_back();
+        }
+    } else {
+        ordinal = free_ordinals_.back();
+        free_ordinals_.pop_back();
+    }
+    documents_[ordinal] = DocumentData{document_id, ComputeAverageRating(ratings), status, static_cast<int>(words.size())};
+    total_document_length_ += words.size();
+    corpus_version_ = WordWeightCache::NewVersion();
     const double inv_word_count = 1.0 / words.size();
 
-    for (const std::string_view word : words) {
-        word_to_document_freqs_[std::string(word)][document_id] += inv_word_count;
-        auto it = word_to_document_freqs_.find(std::string(word));
-        document_to_word_freqs_[document_id][std::string_view(it->first)] += inv_word_count;
+    for (size_t i = 0; i < words.size(); ++i) {
+        const int field = word_fields[i];
+        const double term_freq = field == NO_FIELD ? inv_word_count : field_weights_[field] * inv_word_count;
+        const int term = dictionary_.Add(words[i]);
+        if (term == static_cast<int>(word_to_document_freqs_.size())) {
+            word_to_document_freqs_.emplace_back();
+        }
+        if (!has_quantized_term_freqs_) {
+            word_to_document_freqs_[term].postings[ordinal] += term_freq;
+        }
+        const std::string_view word = dictionary_.GetTerm(term);
+        document_to_word_freqs_[ordinal][word] += term_freq;
+        if (field != NO_FIELD) {
+            auto& document_field_word_freqs = document_to_field_word_freqs_[ordinal];
+            if (document_field_word_freqs.empty()) {
+                document_field_word_freqs.resize(field_names_.size());
+            }
+            field_word_to_document_freqs_[field][word].postings[ordinal] += inv_word_count;
+            document_field_word_freqs[field][word] += inv_word_count;
+        }
+    }
+
+    if (has_quantized_term_freqs_) {
+        inverse_document_lengths_[ordinal] = inv_word_count;
+        for (const auto [word, word_count] : word_counts) {
+            word_to_document_freqs_[dictionary_.Find(word)].quantized_postings.Add(ordinal, word_count);
+        }
+    }
+
+    if (has_positions_) {
+        // A position is skipped where the field changes, so a phrase never spans two fields
+        std::map<std::string_view, std::vector<int>> word_positions;
+        int position = 0;
+        for (size_t i = 0; i < words.size(); ++i, ++position) {
+            if (i > 0 && word_fields[i] != word_fields[i - 1]) {
+                ++position;
+            }
+            word_positions[dictionary_.GetTerm(dictionary_.Find(words[i]))].push_back(position);
+        }
+        auto& document_positions = document_to_word_positions_[ordinal];
+        for (const auto& [word, positions] : word_positions) {
+            document_positions.emplace(word, CompressPositions(positions));
+        }
     }
 
 //*** fill string_view container without find ***//
@@ -31,33 +165,63 @@ void SearchServer::AddDocument(int document_id, std::string_view document, Docum
 //        document_to_word_freqs_[document_id][std::string_view(it->first)] += inv_word_count;
 //    }
 
+    document_id_to_ordinal_.emplace(document_id, ordinal);
     document_ids_.insert(document_id);
 }
 
 void SearchServer::RemoveDocument(int document_id) {
-    if (documents_.count(document_id) == 0) {
+    if (document_id_to_ordinal_.count(document_id) == 0) {
         return;
     }
-    for (const auto [word, _] : document_to_word_freqs_[document_id]) {
-        word_to_document_freqs_[std::string(word)].erase(document_id);
+    const int ordinal = document_id_to_ordinal_.at(document_id);
+    for (const auto [word, _] : document_to_word_freqs_[ordinal]) {
+        RemovePosting(word, ordinal);
     }
+    RemoveFieldPostings(ordinal);
 
-    document_to_word_freqs_.erase(document_id);
+    total_document_length_ -= documents_[ordinal].length;
+    corpus_version_ = WordWeightCache::NewVersion();
+    document_to_word_freqs_[ordinal].clear();
+    if (has_positions_) {
+        document_to_word_positions_[ordinal].clear();
+    }
+    free_ordinals_.push_back(ordinal);
+    document_id_to_ordinal_.erase(document_id);
     document_ids_.erase(document_id);
-    documents_.erase(document_id);
 }
 
-std::vector<Document> SearchServer::FindTopDocuments(std::string_view raw_query, DocumentStatus status) const {
-    return FindTopDocuments(raw_query, [status](int document_id, DocumentStatus document_status, int rating) {
-        return document_status == status;
-    });
-}
-std::vector<Document> SearchServer::FindTopDocuments(std::string_view raw_query) const {
-    return FindTopDocuments(raw_query, DocumentStatus::ACTUAL);
+void SearchServer::RemoveFieldPostings(int ordinal) {
+    if (field_names_.empty()) {
+        return;
+    }
+    auto& document_field_word_freqs = document_to_field_word_freqs_[ordinal];
+    for (size_t field = 0; field < document_field_word_freqs.size(); ++field) {
+        for (const auto [word, _] : document_field_word_freqs[field]) {
+            field_word_to_document_freqs_[field].find(word)->second.postings.erase(ordinal);
+        }
+    }
+    document_field_word_freqs.clear();
 }
 
 int SearchServer::GetDocumentCount() const {
-    return documents_.size();
+    return document_id_to_ordinal_.size();
+}
+
+int SearchServer::GetDocumentLength(int document_id) const {
+    const auto it = document_id_to_ordinal_.find(document_id);
+    return it == document_id_to_ordinal_.end() ? 0 : documents_[it->second].length;
+}
+
+void SearchServer::SetCorpusStatistics(const CorpusStatistics* statistics) {
+    corpus_statistics_ = statistics;
+}
+
+void SearchServer::SetExecutor(ThreadPool* executor) {
+    executor_ = executor;
+}
+
+ThreadPool* SearchServer::GetExecutor() const {
+    return executor_;
 }
 
 std::set<int>::const_iterator SearchServer::begin() const {
@@ -71,11 +235,27 @@ std::set<int>::const_iterator SearchServer::end() const {
 const std::map<std::string_view, double>& SearchServer::GetWordFrequencies(int document_id) const {
     static const std::map<std::string_view, double> empty_map{};
 
-    if (document_to_word_freqs_.count(document_id) == 0) {
+    const auto it = document_id_to_ordinal_.find(document_id);
+    if (it == document_id_to_ordinal_.end()) {
         return empty_map;
     }
 
-    return document_to_word_freqs_.at(document_id);
+    return document_to_word_freqs_[it->second];
+}
+
+const std::map<std::string_view, double>& SearchServer::GetFieldWordFrequencies(std::string_view field, int document_id) const {
+    static const std::map<std::string_view, double> empty_map{};
+
+    const auto field_it = field_ids_.find(field);
+    const auto document_it = document_id_to_ordinal_.find(document_id);
+    if (field_it == field_ids_.end() || document_it == document_id_to_ordinal_.end()) {
+        return empty_map;
+    }
+    const auto& document_field_word_freqs = document_to_field_word_freqs_[document_it->second];
+    if (document_field_word_freqs.empty()) {
+        return empty_map;
+    }
+    return document_field_word_freqs[field_it->second];
 }
 
 std::tuple<std::vector<std::string_view>, DocumentStatus> SearchServer::MatchDocument(std::string_view raw_query, int document_id) const {
@@ -83,64 +263,146 @@ std::tuple<std::vector<std::string_view>, DocumentStatus> SearchServer::MatchDoc
 }
 
 std::tuple<std::vector<std::string_view>, DocumentStatus> SearchServer::MatchDocument(std::execution::sequenced_policy, const std::string_view raw_query, int document_id) const {
-    if (!documents_.count(document_id)) {
-        throw std::out_of_range("Invalid ID"s);
-    }
-
+    const int ordinal = GetOrdinal(document_id);
     const auto query = ParseQuery(raw_query);
-    const auto status = documents_.at(document_id).status;
+    const auto status = documents_[ordinal].status;
 
     for (const std::string_view word : query.minus_words) {
-        if (word_to_document_freqs_.count(word) == 0) {
-            continue;
+        const IndexedWord* indexed_word = FindWord(word);
+        if (indexed_word && HasPosting(*indexed_word, ordinal)) {
+            return {std::vector<std::string_view>{}, status};
         }
-        if (word_to_document_freqs_.at(std::string(word)).count(document_id)) {
+    }
+    for (const auto& [field, word] : query.field_minus_words) {
+        if (HasFieldWord(field, word, ordinal)) {
             return {std::vector<std::string_view>{}, status};
         }
     }
 
+    if (!MatchPhrases(query, ordinal)) {
+        return {std::vector<std::string_view>{}, status};
+    }
+
     std::vector<std::string_view> matched_words;
     for (const std::string_view word : query.plus_words) {
-        if (word_to_document_freqs_.count(word) == 0) {
-            continue;
-        }
-        if (word_to_document_freqs_.at(std::string(word)).count(document_id)) {
+        const IndexedWord* indexed_word = FindWord(word);
+        if (indexed_word && HasPosting(*indexed_word, ordinal)) {
             matched_words.push_back(word);
         }
     }
+    if (!query.field_plus_words.empty()) {
+        for (const auto& [field, word] : query.field_plus_words) {
+            if (HasFieldWord(field, word, ordinal)) {
+                matched_words.push_back(word);
+            }
+        }
+        sort(matched_words.begin(), matched_words.end());
+        matched_words.erase(unique(matched_words.begin(), matched_words.end()), matched_words.end());
+    }
 
     return {matched_words, status};
 }
 
 std::tuple<std::vector<std::string_view>, DocumentStatus> SearchServer::MatchDocument(std::execution::parallel_policy, std::string_view raw_query, int document_id) const {
-    if (!documents_.count(document_id)) {
-        throw std::out_of_range("Invalid ID"s);
-    }
-
+    const int ordinal = GetOrdinal(document_id);
     const auto query = ParseQuery(raw_query, false);
-    const auto status = documents_.at(document_id).status;
+    const auto status = documents_[ordinal].status;
     const auto check_word_contain = [&] (const std::string_view word) {
-        return word_to_document_freqs_.at(std::string(word)).count(document_id);
+        const IndexedWord* indexed_word = FindWord(word);
+        return indexed_word && HasPosting(*indexed_word, ordinal);
+    };
+
+    const auto check_field_word_contain = [&] (const FieldWord& field_word) {
+        return HasFieldWord(field_word.first, field_word.second, ordinal);
     };
 
-    if (std::any_of(query.minus_words.begin(), query.minus_words.end(), check_word_contain)) {
+    if (std::any_of(query.minus_words.begin(), query.minus_words.end(), check_word_contain)
+        || std::any_of(query.field_minus_words.begin(), query.field_minus_words.end(), check_field_word_contain)
+        || !MatchPhrases(query, ordinal)) {
         return {std::vector<std::string_view>{}, status};
     }
 
-    std::vector<std::string_view> matched_words;
-    std::copy_if(
+    std::vector<char> is_matched(query.plus_words.size());
+    ForEach(
         std::execution::par,
-        query.plus_words.begin(), query.plus_words.end(), back_inserter(matched_words),
-        check_word_contain
+        query.plus_words.begin(), query.plus_words.end(),
+        [&](const std::string_view& word) { is_matched[&word - query.plus_words.data()] = check_word_contain(word); }
     );
 
-    sort(std::execution::par, matched_words.begin(), matched_words.end());
+    std::vector<std::string_view> matched_words;
+    for (size_t i = 0; i < query.plus_words.size(); ++i) {
+        if (is_matched[i]) {
+            matched_words.push_back(query.plus_words[i]);
+        }
+    }
+    for (const auto& field_word : query.field_plus_words) {
+        if (check_field_word_contain(field_word)) {
+            matched_words.push_back(field_word.second);
+        }
+    }
+
+    sort(matched_words.begin(), matched_words.end());
     auto i = unique(matched_words.begin(), matched_words.end());
     matched_words.erase(i, matched_words.end());
 
     return {matched_words, status};
 }
 
+DocumentMatches SearchServer::MatchDocuments(std::string_view raw_query, const std::vector<int>& document_ids) const {
+    return MatchDocuments(std::execution::seq, raw_query, document_ids);
+}
+
+const SearchServer::IndexedWord* SearchServer::FindWord(std::string_view word) const {
+    const int term = dictionary_.Find(word);
+    return term == TermDictionary::NO_TERM ? nullptr : &word_to_document_freqs_[term];
+}
+
+const SearchServer::IndexedWord* SearchServer::FindFieldWord(int field, std::string_view word) const {
+    const auto& word_to_document_freqs = field_word_to_document_freqs_[field];
+    const auto it = word_to_document_freqs.find(word);
+    return it == word_to_document_freqs.end() ? nullptr : &it->second;
+}
+
+const SearchServer::Postings* SearchServer::FindFieldPostings(int field, std::string_view word) const {
+    const IndexedWord* indexed_word = FindFieldWord(field, word);
+    return indexed_word ? &indexed_word->postings : nullptr;
+}
+
+bool SearchServer::HasFieldWord(int field, std::string_view word, int ordinal) const {
+    const Postings* postings = FindFieldPostings(field, word);
+    return postings && postings->count(ordinal) > 0;
+}
+
+// Looks the word up in the shorter of the posting list and the document word list
+bool SearchServer::HasWord(const IndexedWord* indexed_word, std::string_view word, int ordinal) const {
+    if (!indexed_word) {
+        return false;
+    }
+    const auto& document_words = document_to_word_freqs_[ordinal];
+    if (document_words.size() < GetPostingCount(*indexed_word)) {
+        return document_words.count(word) > 0;
+    }
+    return HasPosting(*indexed_word, ordinal);
+}
+
+bool SearchServer::HasPosting(const IndexedWord& indexed_word, int ordinal) const {
+    return has_quantized_term_freqs_ ? indexed_word.quantized_postings.Contains(ordinal) : indexed_word.postings.count(ordinal) > 0;
+}
+
+size_t SearchServer::GetPostingCount(const IndexedWord& indexed_word) const {
+    return has_quantized_term_freqs_ ? indexed_word.quantized_postings.size() : indexed_word.postings.size();
+}
+
+// Safe to call for different words concurrently
+void SearchServer::RemovePosting(std::string_view word, int ordinal) {
+    IndexedWord& indexed_word = word_to_document_freqs_[dictionary_.Find(word)];
+    if (has_quantized_term_freqs_) {
+        indexed_word.quantized_postings.Remove(ordinal);
+    } else {
+        indexed_word.postings.erase(ordinal);
+    }
+}
+
 bool SearchServer::IsStopWord(std::string_view word) const {
     return stop_words_.count(word);
 }
@@ -183,17 +445,115 @@ SearchServer::QueryWord SearchServer::ParseQueryWord(std::string_view text) cons
         is_minus = true;
         word = word.substr(1);
     }
+    // "name:word" is a field word only for a registered field name, otherwise the colon is part of the word
+    int field = NO_FIELD;
+    if (const size_t colon = word.find(':'); colon != std::string_view::npos && !field_ids_.empty()) {
+        const auto it = field_ids_.find(word.substr(0, colon));
+        if (it != field_ids_.end()) {
+            field = it->second;
+            word = word.substr(colon + 1);
+        }
+    }
+    bool is_prefix = false;
+    if (!word.empty() && word.back() == '*') {
+        is_prefix = true;
+        word.remove_suffix(1);
+    }
     if (word.empty() || word[0] == '-' || !IsValidWord(word)) {
         throw std::invalid_argument("The request contains invalid symbols");
     }
-    return {word, is_minus, IsStopWord(word)};
+    return {word, is_minus, !is_prefix && IsStopWord(word), is_prefix, field};
+}
+
+void SearchServer::ExpandPrefix(std::string_view prefix, std::vector<std::string_view>& words) const {
+    // Shards expand over the global dictionary, otherwise each would take its own first words
+    // and a sharded search would match more documents than a single server
+    if (corpus_statistics_) {
+        corpus_statistics_->ExpandPrefix(prefix, MAX_PREFIX_EXPANSION_COUNT, words);
+        return;
+    }
+    int expansion_count = 0;
+    dictionary_.ForEachWithPrefix(prefix, [&](int term, std::string_view word) {
+        if (GetPostingCount(word_to_document_freqs_[term]) == 0) {
+            return true;
+        }
+        if (expansion_count++ == MAX_PREFIX_EXPANSION_COUNT) {
+            return false;
+        }
+        words.push_back(word);
+        return true;
+    });
+}
+
+void SearchServer::ExpandFieldPrefix(int field, std::string_view prefix, std::vector<std::string_view>& words) const {
+    if (corpus_statistics_) {
+        corpus_statistics_->ExpandFieldPrefix(field_names_[field], prefix, MAX_PREFIX_EXPANSION_COUNT, words);
+        return;
+    }
+    int expansion_count = 0;
+    const auto& word_to_document_freqs = field_word_to_document_freqs_[field];
+    for (auto it = word_to_document_freqs.lower_bound(prefix);
+         it != word_to_document_freqs.end() && it->first.substr(0, prefix.size()) == prefix; ++it) {
+        if (it->second.postings.empty()) {
+            continue;
+        }
+        if (expansion_count++ == MAX_PREFIX_EXPANSION_COUNT) {
+            return;
+        }
+        words.push_back(it->first);
+    }
 }
 
 SearchServer::Query SearchServer::ParseQuery(std::string_view text, bool do_sort) const {
     Query result;
+    std::vector<std::string_view> phrase;
+    bool is_in_phrase = false;
     for (std::string_view word : SplitIntoWordsView(text)) {
+        if (!is_in_phrase && !word.empty() && word.front() == '"') {
+            is_in_phrase = true;
+            word.remove_prefix(1);
+        }
+        if (is_in_phrase) {
+            const bool is_phrase_end = !word.empty() && word.back() == '"';
+            if (is_phrase_end) {
+                word.remove_suffix(1);
+            }
+            if (!word.empty()) {
+                const auto query_word = ParseQueryWord(word);
+                if (query_word.is_minus || query_word.is_prefix || query_word.field != NO_FIELD) {
+                    throw std::invalid_argument("Phrase contains minus, prefix or field word"s);
+                }
+                if (!query_word.is_stop) {
+                    phrase.push_back(query_word.data);
+                    result.plus_words.push_back(query_word.data);
+                }
+            }
+            if (is_phrase_end) {
+                is_in_phrase = false;
+                // A single word phrase is an ordinary plus word
+                if (phrase.size() > 1) {
+                    result.phrases.push_back(std::move(phrase));
+                }
+                phrase.clear();
+            }
+            continue;
+        }
+
         const auto query_word = ParseQueryWord(word);
-        if (!query_word.is_stop) {
+        if (query_word.field != NO_FIELD) {
+            auto& field_words = query_word.is_minus ? result.field_minus_words : result.field_plus_words;
+            if (query_word.is_prefix) {
+                std::vector<std::string_view> words;
+                ExpandFieldPrefix(query_word.field, query_word.data, words);
+                for (const std::string_view expanded_word : words) {
+                    field_words.emplace_back(query_word.field, expanded_word);
+                }
+            } else if (!query_word.is_stop) {
+                field_words.emplace_back(query_word.field, query_word.data);
+            }
+        } else if (query_word.is_prefix) {
+            ExpandPrefix(query_word.data, query_word.is_minus ? result.minus_words : result.plus_words);
+        } else if (!query_word.is_stop) {
             if (query_word.is_minus) {
                 result.minus_words.push_back(query_word.data);
             } else {
@@ -202,16 +562,162 @@ SearchServer::Query SearchServer::ParseQuery(std::string_view text, bool do_sort
         }
     }
 
+    if (is_in_phrase) {
+        throw std::invalid_argument("Phrase is not closed"s);
+    }
+    if (!result.phrases.empty() && !has_positions_) {
+        throw std::invalid_argument("Phrase queries require positional index"s);
+    }
+
     if (do_sort) {
         sort(result.plus_words.begin(), result.plus_words.end());
         auto i = unique(result.plus_words.begin(), result.plus_words.end());
         result.plus_words.erase(i, result.plus_words.end());
+
+        sort(result.field_plus_words.begin(), result.field_plus_words.end());
+        auto j = unique(result.field_plus_words.begin(), result.field_plus_words.end());
+        result.field_plus_words.erase(j, result.field_plus_words.end());
     }
 
     return result;
 }
 
+int SearchServer::GetCorpusDocumentCount() const {
+    return corpus_statistics_ ? corpus_statistics_->GetDocumentCount() : GetDocumentCount();
+}
+
 // Existence required
-double SearchServer::ComputeWordInverseDocumentFreq(std::string_view word) const {
-    return log(GetDocumentCount() * 1.0 / word_to_document_freqs_.at(std::string(word)).size());
+int SearchServer::GetWordDocumentCount(std::string_view word) const {
+    if (corpus_statistics_) {
+        return corpus_statistics_->GetWordDocumentCount(word);
+    }
+    return GetPostingCount(*FindWord(word));
+}
+
+int SearchServer::GetFieldWordDocumentCount(int field, std::string_view word) const {
+    if (corpus_statistics_) {
+        return corpus_statistics_->GetFieldWordDocumentCount(field_names_[field], word);
+    }
+    const Postings* postings = FindFieldPostings(field, word);
+    return postings ? postings->size() : 0;
+}
+
+// Weights depend on the document counts only, so the shared statistics version them when set
+uint64_t SearchServer::GetCorpusVersion() const {
+    return corpus_statistics_ ? corpus_statistics_->GetVersion() : corpus_version_;
+}
+
+double SearchServer::GetAverageDocumentLength() const {
+    if (corpus_statistics_) {
+        return corpus_statistics_->GetAverageDocumentLength();
+    }
+    return document_id_to_ordinal_.empty() ? 0.0 : total_document_length_ * 1.0 / GetDocumentCount();
+}
+
+int SearchServer::GetOrdinal(int document_id) const {
+    const auto it = document_id_to_ordinal_.find(document_id);
+    if (it == document_id_to_ordinal_.end()) {
+        throw std::out_of_range("Invalid ID"s);
+    }
+    return it->second;
+}
+
+// Ordinals of removed documents are counted too, arrays indexed by ordinal have this size
+int SearchServer::GetOrdinalCount() const {
+    return documents_.size();
+}
+
+std::vector<int> SearchServer::GetWordPositions(int ordinal, std::string_view word) const {
+    if (ordinal >= static_cast<int>(document_to_word_positions_.size())) {
+        return {};
+    }
+    const auto& document_positions = document_to_word_positions_[ordinal];
+    const auto word_it = document_positions.find(word);
+    if (word_it == document_positions.end()) {
+        return {};
+    }
+    return DecompressPositions(word_it->second);
+}
+
+std::vector<int> SearchServer::FindPhraseStarts(const std::vector<std::string_view>& phrase, int ordinal) const {
+    std::vector<std::vector<int>> word_positions;
+    for (const std::string_view word : phrase) {
+        word_positions.push_back(GetWordPositions(ordinal, word));
+    }
+
+    std::vector<int> starts;
+    for (const int start : word_positions[0]) {
+        bool is_found = true;
+        for (size_t i = 1; i < word_positions.size() && is_found; ++i) {
+            is_found = std::binary_search(word_positions[i].begin(), word_positions[i].end(), start + static_cast<int>(i));
+        }
+        if (is_found) {
+            starts.push_back(start);
+        }
+    }
+    return starts;
+}
+
+bool SearchServer::MatchPhrases(const Query& query, int ordinal) const {
+    return std::all_of(query.phrases.begin(), query.phrases.end(), [&](const std::vector<std::string_view>& phrase) {
+        return !FindPhraseStarts(phrase, ordinal).empty();
+    });
+}
+
+// Terms are the phrases and the plus words outside them. Every occurrence of a term is a span
+// of positions, a phrase match spans all its words
+double SearchServer::ComputeProximityFactor(const Query& query, int ordinal) const {
+    struct Span {
+        int first;
+        int last;
+        int term;
+    };
+    std::vector<Span> spans;
+    std::set<std::string_view> phrase_words;
+    int term = 0;
+    for (const auto& phrase : query.phrases) {
+        for (const int start : FindPhraseStarts(phrase, ordinal)) {
+            spans.push_back({start, start + static_cast<int>(phrase.size()) - 1, term});
+        }
+        phrase_words.insert(phrase.begin(), phrase.end());
+        ++term;
+    }
+    for (const std::string_view word : query.plus_words) {
+        if (phrase_words.count(word) > 0) {
+            continue;
+        }
+        for (const int position : GetWordPositions(ordinal, word)) {
+            spans.push_back({position, position, term});
+        }
+        ++term;
+    }
+    sort(spans.begin(), spans.end(), [](const Span& lhs, const Span& rhs) {
+        return lhs.first < rhs.first;
+    });
+
+    // The nearest earlier span of another term ends at the largest end among the earlier spans,
+    // or at the largest end of the other terms when that one is of the same term
+    int min_distance = 0;
+    int last_end = -1;
+    int last_term = -1;
+    int other_last_end = -1;
+    for (const Span& span : spans) {
+        const int end = span.term != last_term ? last_end : other_last_end;
+        if (end >= 0) {
+            const int distance = std::max(span.first - end, 1);
+            if (min_distance == 0 || distance < min_distance) {
+                min_distance = distance;
+            }
+        }
+        if (span.term == last_term) {
+            last_end = std::max(last_end, span.last);
+        } else if (span.last > last_end) {
+            other_last_end = last_end;
+            last_end = span.last;
+            last_term = span.term;
+        } else {
+            other_last_end = std::max(other_last_end, span.last);
+        }
+    }
+    return min_distance == 0 ? 1.0 : 1.0 + PROXIMITY_WEIGHT / min_distance;
 }
@@ -1,7 +1,15 @@
 #pragma once
 #include "document.h"
+#include "paginator.h"
 #include "string_processing.h"
 #include "concurrent_map.h"
+#include "corpus_statistics.h"
+#include "thread_pool.h"
+#include "position_codec.h"
+#include "ranking.h"
+#include "scoring_kernels.h"
+#include "term_dictionary.h"
+#include "word_weight_cache.h"
 
 #include <string>
 #include <vector>
@@ -13,8 +21,32 @@
 #include <numeric>
 #include <execution>
 #include <future>
+#include <type_traits>
 
 const int MAX_RESULT_DOCUMENT_COUNT = 5;
+// For a query with a phrase, relevance of a document is multiplied by 1 + PROXIMITY_WEIGHT / distance,
+// where distance is the smallest gap between a match of a phrase and another query term in it: another
+// phrase or a plus word from outside the phrases. Words inside one phrase do not count as close
+const double PROXIMITY_WEIGHT = 0.5;
+// A "prefix*" query word is replaced by at most this many indexed words, taken in lexicographic order
+const int MAX_PREFIX_EXPANSION_COUNT = 64;
+
+// Result of SearchServer::MatchDocuments in flat arrays. Matched words of the i-th
+// document are words[offsets[i]] .. words[offsets[i + 1]]
+struct DocumentMatches {
+    std::vector<std::string_view> words;
+    std::vector<size_t> offsets;
+    std::vector<DocumentStatus> statuses;
+
+    size_t size() const;
+    IteratorRange<std::vector<std::string_view>::const_iterator> GetWords(size_t index) const;
+};
+
+// A named part of a document, e.g. title or body. The field must be registered with SearchServer::AddField
+struct DocumentField {
+    std::string_view name;
+    std::string_view text;
+};
 
 class SearchServer {
 public:
@@ -23,49 +55,141 @@ public:
     explicit SearchServer(const std::string& stop_words_text);
     explicit SearchServer(std::string_view stop_words_text);
 
+    // Word positions enable "quoted phrase" queries and their proximity boost; queries
+    // without phrases never read positions. Must be called before the first document is added
+    void EnablePositionalIndex();
+    // Word counts are kept in compact 8/16-bit posting blocks instead of the double postings.
+    // Sequential TF-IDF search scores them with the kernels from scoring_kernels.h, other
+    // rankings and the parallel version take the term frequency as count / document length.
+    // Must be called before the first document is added
+    void EnableQuantizedTermFrequencies();
+
+    // Words of the field count weight times in the document word frequencies, so plain query
+    // words see the weights without extra postings reads. A "field:word" query word searches
+    // the postings of this field only and its score is multiplied by the weight.
+    // Must be called before the first document is added
+    void AddField(std::string_view name, double weight = 1.0);
+
     void AddDocument(int document_id, std::string_view document, DocumentStatus status, const std::vector<int>& ratings);
+    // Document length spans the fields in the given order. So do word positions, with a gap
+    // between fields: a phrase matches within one field only
+    void AddDocument(int document_id, const std::vector<DocumentField>& fields, DocumentStatus status, const std::vector<int>& ratings);
 
     template <typename ExecutionPolicy>
     void RemoveDocument(ExecutionPolicy&& policy, int document_id);
     void RemoveDocument(int document_id);
 
-    template <typename DocumentPredicate>
+    // Ranking is a policy from ranking.h, e.g. FindTopDocuments<Bm25Ranking>(std::execution::seq, query)
+    template <typename Ranking = TfIdfRanking, typename DocumentPredicate>
     std::vector<Document> FindTopDocuments(std::string_view raw_query, DocumentPredicate document_predicate) const;
+    template <typename Ranking = TfIdfRanking>
     std::vector<Document> FindTopDocuments(std::string_view raw_query, DocumentStatus status) const;
+    template <typename Ranking = TfIdfRanking>
     std::vector<Document> FindTopDocuments(std::string_view raw_query) const;
 
-    template <typename ExecutionPolicy, typename DocumentPredicate>
+    template <typename Ranking = TfIdfRanking, typename ExecutionPolicy, typename DocumentPredicate>
     std::vector<Document> FindTopDocuments(ExecutionPolicy&& policy, std::string_view raw_query, DocumentPredicate document_predicate) const;
 
-    template <typename ExecutionPolicy>
+    template <typename Ranking = TfIdfRanking, typename ExecutionPolicy>
     std::vector<Document> FindTopDocuments(ExecutionPolicy&& policy, std::string_view raw_query, DocumentStatus status) const;
 
-    template <typename ExecutionPolicy>
+    template <typename Ranking = TfIdfRanking, typename ExecutionPolicy>
     std::vector<Document> FindTopDocuments(ExecutionPolicy&& policy, std::string_view raw_query) const;
 
+    // Page of page_size documents ranked after the cursor, see SearchCursor.
+    // Costs O(matches + matches * log(page_size)) for any page number
+    template <typename Ranking = TfIdfRanking, typename DocumentPredicate>
+    DocumentPage FindDocumentsPage(std::string_view raw_query, DocumentPredicate document_predicate, size_t page_size,
+                                   const std::optional<SearchCursor>& after = std::nullopt) const;
+    template <typename Ranking = TfIdfRanking>
+    DocumentPage FindDocumentsPage(std::string_view raw_query, DocumentStatus status, size_t page_size,
+                                   const std::optional<SearchCursor>& after = std::nullopt) const;
+
+    template <typename Ranking = TfIdfRanking, typename ExecutionPolicy, typename DocumentPredicate>
+    DocumentPage FindDocumentsPage(ExecutionPolicy&& policy, std::string_view raw_query, DocumentPredicate document_predicate, size_t page_size,
+                                   const std::optional<SearchCursor>& after = std::nullopt) const;
+
     std::set<int>::const_iterator begin() const;
     std::set<int>::const_iterator end() const;
 
     int GetDocumentCount() const;
 
+    // Number of words without stop words
+    int GetDocumentLength(int document_id) const;
+
+    // Shared statistics replace the local ones in IDF computation.
+    // Used by ShardedSearchServer to keep IDF global across shards
+    void SetCorpusStatistics(const CorpusStatistics* statistics);
+
+    // Parallel execution policy runs on the executor instead of std::execution::par when it is set
+    void SetExecutor(ThreadPool* executor);
+    ThreadPool* GetExecutor() const;
+
     const std::map<std::string_view, double>& GetWordFrequencies(int document_id) const;
+    // Share of the document words that are this word in this field, field weight not applied
+    const std::map<std::string_view, double>& GetFieldWordFrequencies(std::string_view field, int document_id) const;
 
     std::tuple<std::vector<std::string_view>, DocumentStatus> MatchDocument(std::string_view raw_query, int document_id) const;
     std::tuple<std::vector<std::string_view>, DocumentStatus> MatchDocument(std::execution::sequenced_policy, const std::string_view raw_query, int document_id) const;
     std::tuple<std::vector<std::string_view>, DocumentStatus> MatchDocument(std::execution::parallel_policy, std::string_view raw_query, int document_id) const;
 
+    // MatchDocument for many documents: the query is parsed and its words are looked up once
+    template <typename ExecutionPolicy>
+    DocumentMatches MatchDocuments(ExecutionPolicy&& policy, std::string_view raw_query, const std::vector<int>& document_ids) const;
+    DocumentMatches MatchDocuments(std::string_view raw_query, const std::vector<int>& document_ids) const;
+
 private:
     struct DocumentData {
+        int id;
         int rating;
         DocumentStatus status;
+        int length;
     };
 
     const std::set<std::string, std::less<>> stop_words_;
     std::set<int> document_ids_;
 
-    std::map<std::string, std::map<int, double>, std::less<>> word_to_document_freqs_;
-    std::map<int, std::map<std::string_view, double>> document_to_word_freqs_;
-    std::map<int, DocumentData> documents_;
+    // Documents are stored by dense ordinals assigned in AddDocument. Postings and
+    // the per-document arrays below are indexed by ordinal, external ids are used
+    // only at the API boundary. Ordinals of removed documents are reused
+    std::map<int, int> document_id_to_ordinal_;
+    std::vector<int> free_ordinals_;
+
+    using Postings = std::map<int, double>;
+    // Postings of a word along with its weights, which are cached per corpus version.
+    // Words of the whole document keep either postings or quantized_postings, depending on
+    // has_quantized_term_freqs_; field words always keep postings
+    struct IndexedWord {
+        Postings postings;
+        QuantizedPostings quantized_postings;
+        WordWeightCache weights;
+    };
+
+    // Indexed by term id of dictionary_, whose terms back the string_views of all words below
+    TermDictionary dictionary_;
+    std::vector<IndexedWord> word_to_document_freqs_;
+    std::vector<std::map<std::string_view, double>> document_to_word_freqs_;
+    std::vector<DocumentData> documents_;
+    int64_t total_document_length_ = 0;
+    // Changes with every added or removed document, used when there are no shared statistics
+    uint64_t corpus_version_ = WordWeightCache::NewVersion();
+
+    bool has_positions_ = false;
+    std::vector<std::map<std::string_view, std::vector<uint8_t>>> document_to_word_positions_;
+
+    bool has_quantized_term_freqs_ = false;
+    std::vector<double> inverse_document_lengths_;
+
+    // Fields are numbered in registration order. Each field has its own postings over the
+    // shared dictionary, documents added without fields have none
+    std::map<std::string, int, std::less<>> field_ids_;
+    std::vector<std::string_view> field_names_;
+    std::vector<double> field_weights_;
+    std::vector<std::map<std::string_view, IndexedWord>> field_word_to_document_freqs_;
+    std::vector<std::vector<std::map<std::string_view, double>>> document_to_field_word_freqs_;
+
+    const CorpusStatistics* corpus_statistics_ = nullptr;
+    ThreadPool* executor_ = nullptr;
 
     bool IsStopWord(std::string_view word) const;
     static bool IsValidWord(std::string_view word);
@@ -74,30 +198,95 @@ private:
 
     static int ComputeAverageRating(const std::vector<int>& ratings);
 
+    int GetOrdinal(int document_id) const;
+    int GetOrdinalCount() const;
+
+    static constexpr int NO_FIELD = -1;
+
+    // word_fields[i] is the field id of words[i] or NO_FIELD
+    void AddDocumentWords(int document_id, const std::vector<std::string_view>& words, const std::vector<int>& word_fields,
+                          DocumentStatus status, const std::vector<int>& ratings);
+    void RemoveFieldPostings(int ordinal);
+
     struct QueryWord {
         std::string_view data;
         bool is_minus;
         bool is_stop;
+        bool is_prefix;
+        int field;
     };
 
+    // Field id and word of a "field:word" query word
+    using FieldWord = std::pair<int, std::string_view>;
+
     struct Query {
         std::vector<std::string_view> plus_words;
         std::vector<std::string_view> minus_words;
+        std::vector<std::vector<std::string_view>> phrases;
+        std::vector<FieldWord> field_plus_words;
+        std::vector<FieldWord> field_minus_words;
     };
 
     QueryWord ParseQueryWord(std::string_view text) const;
+    // Words with the prefix in lexicographic order, of the whole corpus when statistics are shared
+    void ExpandPrefix(std::string_view prefix, std::vector<std::string_view>& words) const;
+    // The same over the words of one field
+    void ExpandFieldPrefix(int field, std::string_view prefix, std::vector<std::string_view>& words) const;
     Query ParseQuery(std::string_view text, bool do_sort = true) const;
 
-    double ComputeWordInverseDocumentFreq(std::string_view word) const;
-
-    template <typename DocumentPredicate>
-    std::vector<Document> FindAllDocuments(const Query& query, DocumentPredicate document_predicate) const;
-
-    template <typename DocumentPredicate>
+    int GetCorpusDocumentCount() const;
+    int GetWordDocumentCount(std::string_view word) const;
+    int GetFieldWordDocumentCount(int field, std::string_view word) const;
+    double GetAverageDocumentLength() const;
+    uint64_t GetCorpusVersion() const;
+
+    template <typename Ranking>
+    double ComputeWordWeight(std::string_view word) const;
+    // Includes the field weight
+    template <typename Ranking>
+    double ComputeFieldWordWeight(int field, std::string_view word) const;
+    // Cached versions of the above for an indexed word
+    template <typename Ranking>
+    double GetWordWeight(const IndexedWord& indexed_word, std::string_view word) const;
+    template <typename Ranking>
+    double GetFieldWordWeight(const IndexedWord& indexed_word, int field, std::string_view word) const;
+
+    std::vector<int> GetWordPositions(int ordinal, std::string_view word) const;
+    // Positions where the phrase starts in the document
+    std::vector<int> FindPhraseStarts(const std::vector<std::string_view>& phrase, int ordinal) const;
+    bool MatchPhrases(const Query& query, int ordinal) const;
+    double ComputeProximityFactor(const Query& query, int ordinal) const;
+
+    const IndexedWord* FindWord(std::string_view word) const;
+    const IndexedWord* FindFieldWord(int field, std::string_view word) const;
+    const Postings* FindFieldPostings(int field, std::string_view word) const;
+    bool HasFieldWord(int field, std::string_view word, int ordinal) const;
+    bool HasWord(const IndexedWord* indexed_word, std::string_view word, int ordinal) const;
+
+    // Postings of a document word, whichever of the two kinds the server keeps
+    bool HasPosting(const IndexedWord& indexed_word, int ordinal) const;
+    size_t GetPostingCount(const IndexedWord& indexed_word) const;
+    // Calls function(ordinal, term_freq) for the postings in ordinal order
+    template <typename Function>
+    void ForEachPosting(const IndexedWord& indexed_word, Function function) const;
+    void RemovePosting(std::string_view word, int ordinal);
+
+    // DocumentToRelevance is a range of (ordinal, relevance) pairs
+    template <typename DocumentToRelevance>
+    std::vector<Document> CollectDocuments(const Query& query, const DocumentToRelevance& document_to_relevance) const;
+
+    template <typename ExecutionPolicy, typename Iterator, typename Function>
+    void ForEach(ExecutionPolicy&& policy, Iterator first, Iterator last, Function function) const;
+
+    // Matched documents in no particular order: callers rank them with IsRankedBefore,
+    // which does not depend on it
+    template <typename Ranking, typename DocumentPredicate>
     std::vector<Document> FindAllDocuments(std::execution::parallel_policy, const Query& query, DocumentPredicate document_predicate) const;
 
-    template <typename DocumentPredicate>
+    template <typename Ranking, typename DocumentPredicate>
     std::vector<Document> FindAllDocuments(std::execution::sequenced_policy, const Query& query, DocumentPredicate document_predicate) const;
+    template <typename DocumentPredicate>
+    std::vector<Document> FindAllDocumentsQuantized(const Query& query, DocumentPredicate document_predicate) const;
 };
 
 template <typename StringContainer>
@@ -112,139 +301,406 @@ SearchServer::SearchServer(const StringContainer& stop_words)
 
 template <typename ExecutionPolicy>
 void SearchServer::RemoveDocument(ExecutionPolicy&& policy, int document_id) {
-    if (documents_.count(document_id) == 0) {
+    if (document_id_to_ordinal_.count(document_id) == 0) {
         return;
     }
+    const int ordinal = document_id_to_ordinal_.at(document_id);
     std::vector<std::string_view> words;
 
-    for (const auto [word, _] : document_to_word_freqs_[document_id]) {
+    for (const auto [word, _] : document_to_word_freqs_[ordinal]) {
         words.push_back(word);
     }
 
-    std::for_each(
+    ForEach(
         policy,
         words.begin(), words.end(),
-        [&](const std::string_view word) { word_to_document_freqs_[std::string(word)].erase(document_id); }
+        [&](const std::string_view word) { RemovePosting(word, ordinal); }
     );
 
-    documents_.erase(document_id);
-    document_to_word_freqs_.erase(document_id);
+    RemoveFieldPostings(ordinal);
+
+    total_document_length_ -= documents_[ordinal].length;
+    corpus_version_ = WordWeightCache::NewVersion();
+    document_to_word_freqs_[ordinal].clear();
+    if (has_positions_) {
+        document_to_word_positions_[ordinal].clear();
+    }
+    free_ordinals_.push_back(ordinal);
+    document_id_to_ordinal_.erase(document_id);
     document_ids_.erase(document_id);
 }
 
-template <typename DocumentPredicate>
-std::vector<Document> SearchServer::FindTopDocuments(std::string_view raw_query, DocumentPredicate document_predicate) const {
-    return FindTopDocuments(std::execution::seq, raw_query, document_predicate);
+template <typename ExecutionPolicy, typename Iterator, typename Function>
+void SearchServer::ForEach(ExecutionPolicy&& policy, Iterator first, Iterator last, Function function) const {
+    if constexpr (std::is_same_v<std::decay_t<ExecutionPolicy>, std::execution::parallel_policy>) {
+        if (executor_) {
+            executor_->ForEach(first, last, function);
+            return;
+        }
+    }
+    std::for_each(policy, first, last, function);
 }
 
-template <typename ExecutionPolicy, typename DocumentPredicate>
-std::vector<Document> SearchServer::FindTopDocuments(ExecutionPolicy&& policy, std::string_view raw_query, DocumentPredicate document_predicate) const {
+template <typename ExecutionPolicy>
+DocumentMatches SearchServer::MatchDocuments(ExecutionPolicy&& policy, std::string_view raw_query, const std::vector<int>& document_ids) const {
+    std::vector<int> ordinals;
+    ordinals.reserve(document_ids.size());
+    for (const int document_id : document_ids) {
+        ordinals.push_back(GetOrdinal(document_id));
+    }
+
     const auto query = ParseQuery(raw_query);
-    const double EPSILON = 1e-6;
-    auto matched_documents = FindAllDocuments(policy, query, document_predicate);
+    std::vector<const IndexedWord*> plus_indexed_words;
+    for (const std::string_view word : query.plus_words) {
+        plus_indexed_words.push_back(FindWord(word));
+    }
+    std::vector<const IndexedWord*> minus_indexed_words;
+    for (const std::string_view word : query.minus_words) {
+        minus_indexed_words.push_back(FindWord(word));
+    }
+    std::vector<const Postings*> field_plus_postings;
+    for (const auto& [field, word] : query.field_plus_words) {
+        field_plus_postings.push_back(FindFieldPostings(field, word));
+    }
+    std::vector<const Postings*> field_minus_postings;
+    for (const auto& [field, word] : query.field_minus_words) {
+        field_minus_postings.push_back(FindFieldPostings(field, word));
+    }
+    const auto has_field_word = [](const Postings* postings, int ordinal) {
+        return postings && postings->count(ordinal) > 0;
+    };
 
-    sort(matched_documents.begin(), matched_documents.end(), [EPSILON](const Document& lhs, const Document& rhs) {
-        if (std::abs(lhs.relevance - rhs.relevance) < EPSILON) {
-            return lhs.rating > rhs.rating;
-        } else {
-            return lhs.relevance > rhs.relevance;
+    // Row per document, column per plus word, then per field plus word
+    const size_t plus_word_count = query.plus_words.size();
+    const size_t word_count = plus_word_count + query.field_plus_words.size();
+    std::vector<char> is_matched(ordinals.size() * word_count);
+    ForEach(
+        policy,
+        ordinals.begin(), ordinals.end(),
+        [&](const int& ordinal) {
+            for (size_t i = 0; i < minus_indexed_words.size(); ++i) {
+                if (HasWord(minus_indexed_words[i], query.minus_words[i], ordinal)) {
+                    return;
+                }
+            }
+            for (const Postings* postings : field_minus_postings) {
+                if (has_field_word(postings, ordinal)) {
+                    return;
+                }
+            }
+            if (!MatchPhrases(query, ordinal)) {
+                return;
+            }
+            char* row = is_matched.data() + (&ordinal - ordinals.data()) * word_count;
+            for (size_t i = 0; i < plus_word_count; ++i) {
+                row[i] = HasWord(plus_indexed_words[i], query.plus_words[i], ordinal);
+            }
+            for (size_t i = plus_word_count; i < word_count; ++i) {
+                row[i] = has_field_word(field_plus_postings[i - plus_word_count], ordinal);
+            }
+        }
+    );
+
+    DocumentMatches result;
+    result.offsets.reserve(document_ids.size() + 1);
+    result.statuses.reserve(document_ids.size());
+    result.offsets.push_back(0);
+    for (size_t row = 0; row < ordinals.size(); ++row) {
+        for (size_t i = 0; i < word_count; ++i) {
+            if (is_matched[row * word_count + i]) {
+                result.words.push_back(i < plus_word_count ? query.plus_words[i] : query.field_plus_words[i - plus_word_count].second);
+            }
+        }
+        if (!query.field_plus_words.empty()) {
+            const auto row_begin = result.words.begin() + result.offsets.back();
+            sort(row_begin, result.words.end());
+            result.words.erase(unique(row_begin, result.words.end()), result.words.end());
+        }
+        result.offsets.push_back(result.words.size());
+        result.statuses.push_back(documents_[ordinals[row]].status);
+    }
+    return result;
+}
+
+template <typename Ranking>
+double SearchServer::ComputeWordWeight(std::string_view word) const {
+    return Ranking::ComputeWordWeight(GetCorpusDocumentCount(), GetWordDocumentCount(word));
+}
+
+template <typename Ranking>
+double SearchServer::ComputeFieldWordWeight(int field, std::string_view word) const {
+    return field_weights_[field] * Ranking::ComputeWordWeight(GetCorpusDocumentCount(), GetFieldWordDocumentCount(field, word));
+}
+
+template <typename Ranking>
+double SearchServer::GetWordWeight(const IndexedWord& indexed_word, std::string_view word) const {
+    return indexed_word.weights.Get<Ranking>(GetCorpusVersion(), [&] { return ComputeWordWeight<Ranking>(word); });
+}
+
+template <typename Ranking>
+double SearchServer::GetFieldWordWeight(const IndexedWord& indexed_word, int field, std::string_view word) const {
+    return indexed_word.weights.Get<Ranking>(GetCorpusVersion(), [&] { return ComputeFieldWordWeight<Ranking>(field, word); });
+}
+
+template <typename Function>
+void SearchServer::ForEachPosting(const IndexedWord& indexed_word, Function function) const {
+    if (has_quantized_term_freqs_) {
+        indexed_word.quantized_postings.ForEach([&](int ordinal, int word_count) {
+            function(ordinal, word_count * inverse_document_lengths_[ordinal]);
+        });
+    } else {
+        for (const auto [ordinal, term_freq] : indexed_word.postings) {
+            function(ordinal, term_freq);
         }
-    });
-    if (matched_documents.size() > MAX_RESULT_DOCUMENT_COUNT) {
-        matched_documents.resize(MAX_RESULT_DOCUMENT_COUNT);
     }
+}
+
+template <typename Ranking, typename DocumentPredicate>
+std::vector<Document> SearchServer::FindTopDocuments(std::string_view raw_query, DocumentPredicate document_predicate) const {
+    return FindTopDocuments<Ranking>(std::execution::seq, raw_query, document_predicate);
+}
+
+template <typename Ranking>
+std::vector<Document> SearchServer::FindTopDocuments(std::string_view raw_query, DocumentStatus status) const {
+    return FindTopDocuments<Ranking>(std::execution::seq, raw_query, status);
+}
+
+template <typename Ranking>
+std::vector<Document> SearchServer::FindTopDocuments(std::string_view raw_query) const {
+    return FindTopDocuments<Ranking>(std::execution::seq, raw_query, DocumentStatus::ACTUAL);
+}
+
+template <typename Ranking, typename ExecutionPolicy, typename DocumentPredicate>
+std::vector<Document> SearchServer::FindTopDocuments(ExecutionPolicy&& policy, std::string_view raw_query, DocumentPredicate document_predicate) const {
+    const auto query = ParseQuery(raw_query);
+    auto matched_documents = FindAllDocuments<Ranking>(policy, query, document_predicate);
+
+    // IsRankedBefore is a strict total order, so partial_sort is well defined and the top
+    // is the one the sharded merge selects from the same documents
+    const size_t top_count = std::min<size_t>(MAX_RESULT_DOCUMENT_COUNT, matched_documents.size());
+    std::partial_sort(matched_documents.begin(), matched_documents.begin() + top_count, matched_documents.end(), IsRankedBefore);
+    matched_documents.resize(top_count);
     return matched_documents;
 }
 
-template <typename ExecutionPolicy>
+template <typename Ranking, typename ExecutionPolicy>
 std::vector<Document> SearchServer::FindTopDocuments(ExecutionPolicy&& policy, std::string_view raw_query, DocumentStatus status) const {
-    return FindTopDocuments(policy, raw_query, [status](int document_id, DocumentStatus document_status, int rating) {
+    return FindTopDocuments<Ranking>(policy, raw_query, [status](int document_id, DocumentStatus document_status, int rating) {
         return document_status == status;
     });
 }
 
-template <typename ExecutionPolicy>
+template <typename Ranking, typename ExecutionPolicy>
 std::vector<Document> SearchServer::FindTopDocuments(ExecutionPolicy&& policy, std::string_view raw_query) const {
-    return FindTopDocuments(policy, raw_query, DocumentStatus::ACTUAL);
+    return FindTopDocuments<Ranking>(policy, raw_query, DocumentStatus::ACTUAL);
 }
 
-template <typename DocumentPredicate>
-std::vector<Document> SearchServer::FindAllDocuments(const Query& query, DocumentPredicate document_predicate) const {
-    return FindAllDocuments(std::execution::seq, query, document_predicate);
+template <typename Ranking, typename DocumentPredicate>
+DocumentPage SearchServer::FindDocumentsPage(std::string_view raw_query, DocumentPredicate document_predicate, size_t page_size,
+                                             const std::optional<SearchCursor>& after) const {
+    return FindDocumentsPage<Ranking>(std::execution::seq, raw_query, document_predicate, page_size, after);
 }
 
-template <typename DocumentPredicate>
+template <typename Ranking>
+DocumentPage SearchServer::FindDocumentsPage(std::string_view raw_query, DocumentStatus status, size_t page_size,
+                                             const std::optional<SearchCursor>& after) const {
+    return FindDocumentsPage<Ranking>(raw_query, [status](int document_id, DocumentStatus document_status, int rating) {
+        return document_status == status;
+    }, page_size, after);
+}
+
+template <typename Ranking, typename ExecutionPolicy, typename DocumentPredicate>
+DocumentPage SearchServer::FindDocumentsPage(ExecutionPolicy&& policy, std::string_view raw_query, DocumentPredicate document_predicate, size_t page_size,
+                                             const std::optional<SearchCursor>& after) const {
+    const auto query = ParseQuery(raw_query);
+    return MakeDocumentPage(FindAllDocuments<Ranking>(policy, query, document_predicate), page_size, after);
+}
+
+template <typename Ranking, typename DocumentPredicate>
 std::vector<Document> SearchServer::FindAllDocuments(std::execution::sequenced_policy, const Query& query, DocumentPredicate document_predicate) const {
-    std::map<int, double> document_to_relevance;
+    if constexpr (std::is_same_v<Ranking, TfIdfRanking>) {
+        if (has_quantized_term_freqs_ && query.field_plus_words.empty() && query.field_minus_words.empty()) {
+            return FindAllDocumentsQuantized(query, document_predicate);
+        }
+    }
+    const double average_document_length = GetAverageDocumentLength();
+    // Flat accumulators indexed by ordinal, matched ordinals are collected separately
+    // so that the result is built without scanning the whole corpus
+    std::vector<double> relevance(GetOrdinalCount());
+    std::vector<char> is_matched(GetOrdinalCount());
+    std::vector<int> matched_ordinals;
+    const auto add_posting = [&](int ordinal, double term_freq, double word_weight) {
+        const auto& document_data = documents_[ordinal];
+        if (document_predicate(document_data.id, document_data.status, document_data.rating)) {
+            relevance[ordinal] += Ranking::ComputeScore(term_freq, document_data.length, average_document_length, word_weight);
+            if (!is_matched[ordinal]) {
+                is_matched[ordinal] = 1;
+                matched_ordinals.push_back(ordinal);
+            }
+        }
+    };
+    const auto exclude_posting = [&](int ordinal, double) {
+        is_matched[ordinal] = 0;
+    };
+
     for (std::string_view word : query.plus_words) {
-        if (word_to_document_freqs_.count(word) == 0) {
-            continue;
+        if (const IndexedWord* indexed_word = FindWord(word)) {
+            const double word_weight = GetWordWeight<Ranking>(*indexed_word, word);
+            ForEachPosting(*indexed_word, [&](int ordinal, double term_freq) { add_posting(ordinal, term_freq, word_weight); });
         }
-        const double inverse_document_freq = ComputeWordInverseDocumentFreq(word);
-        for (const auto [document_id, term_freq] : word_to_document_freqs_.at(std::string(word))) {
-            const auto& document_data = documents_.at(document_id);
-            if (document_predicate(document_id, document_data.status, document_data.rating)) {
-                document_to_relevance[document_id] += term_freq * inverse_document_freq;
+    }
+    for (const auto& [field, word] : query.field_plus_words) {
+        const IndexedWord* indexed_word = FindFieldWord(field, word);
+        if (indexed_word && !indexed_word->postings.empty()) {
+            const double word_weight = GetFieldWordWeight<Ranking>(*indexed_word, field, word);
+            for (const auto [ordinal, term_freq] : indexed_word->postings) {
+                add_posting(ordinal, term_freq, word_weight);
             }
         }
     }
 
     for (std::string_view word : query.minus_words) {
-        if (word_to_document_freqs_.count(word) == 0) {
-            continue;
+        if (const IndexedWord* indexed_word = FindWord(word)) {
+            ForEachPosting(*indexed_word, exclude_posting);
         }
-        for (const auto [document_id, _] : word_to_document_freqs_.at(std::string(word))) {
-            document_to_relevance.erase(document_id);
+    }
+    for (const auto& [field, word] : query.field_minus_words) {
+        if (const Postings* postings = FindFieldPostings(field, word)) {
+            for (const auto [ordinal, term_freq] : *postings) {
+                exclude_posting(ordinal, term_freq);
+            }
         }
     }
 
-    std::vector<Document> matched_documents;
-    for (const auto [document_id, relevance] : document_to_relevance) {
-        matched_documents.push_back({document_id, relevance, documents_.at(document_id).rating});
+    std::vector<std::pair<int, double>> document_to_relevance;
+    document_to_relevance.reserve(matched_ordinals.size());
+    for (const int ordinal : matched_ordinals) {
+        if (is_matched[ordinal]) {
+            document_to_relevance.emplace_back(ordinal, relevance[ordinal]);
+        }
     }
-    return matched_documents;
+    return CollectDocuments(query, document_to_relevance);
 }
 
+// The predicate is checked once per matched document instead of once per posting
 template <typename DocumentPredicate>
+std::vector<Document> SearchServer::FindAllDocumentsQuantized(const Query& query, DocumentPredicate document_predicate) const {
+    std::vector<double> relevance(GetOrdinalCount());
+    std::vector<char> is_matched(GetOrdinalCount());
+    std::vector<int> matched_ordinals;
+    for (std::string_view word : query.plus_words) {
+        const IndexedWord* indexed_word = FindWord(word);
+        if (!indexed_word || indexed_word->quantized_postings.empty()) {
+            continue;
+        }
+        const QuantizedPostings& postings = indexed_word->quantized_postings;
+        postings.AccumulateScores(inverse_document_lengths_.data(), GetWordWeight<TfIdfRanking>(*indexed_word, word), relevance.data());
+        postings.ForEach([&](int ordinal, int) {
+            if (!is_matched[ordinal]) {
+                is_matched[ordinal] = 1;
+                matched_ordinals.push_back(ordinal);
+            }
+        });
+    }
+
+    for (std::string_view word : query.minus_words) {
+        if (const IndexedWord* indexed_word = FindWord(word)) {
+            indexed_word->quantized_postings.ForEach([&](int ordinal, int) { is_matched[ordinal] = 0; });
+        }
+    }
+
+    std::vector<std::pair<int, double>> document_to_relevance;
+    document_to_relevance.reserve(matched_ordinals.size());
+    for (const int ordinal : matched_ordinals) {
+        const auto& document_data = documents_[ordinal];
+        if (is_matched[ordinal] && document_predicate(document_data.id, document_data.status, document_data.rating)) {
+            document_to_relevance.emplace_back(ordinal, relevance[ordinal]);
+        }
+    }
+    return CollectDocuments(query, document_to_relevance);
+}
+
+template <typename Ranking, typename DocumentPredicate>
 std::vector<Document> SearchServer::FindAllDocuments(std::execution::parallel_policy, const Query& query, DocumentPredicate document_predicate) const {
+    const double average_document_length = GetAverageDocumentLength();
     ConcurrentMap<int, double> cm_document_to_relevance(document_ids_.size());
 
-    auto updater = [&](const std::string_view word) {
-        if (word_to_document_freqs_.count(word)) {
-            const double inverse_document_freq = ComputeWordInverseDocumentFreq(word);
-            for (const auto [document_id, term_freq] : word_to_document_freqs_.at(std::string(word))) {
-                const auto& document_data = documents_.at(document_id);
-                if (document_predicate(document_id, document_data.status, document_data.rating)) {
-                    cm_document_to_relevance[document_id].ref_to_value += term_freq * inverse_document_freq;
-                }
-            }
+    auto updater = [&](int ordinal, double term_freq, double word_weight) {
+        const auto& document_data = documents_[ordinal];
+        if (document_predicate(document_data.id, document_data.status, document_data.rating)) {
+            cm_document_to_relevance.Add(
+                ordinal, Ranking::ComputeScore(term_freq, document_data.length, average_document_length, word_weight));
         }
     };
 
-    std::for_each(
+    ForEach(
         std::execution::par,
         query.plus_words.begin(), query.plus_words.end(),
-        [&](const std::string_view word) { updater(word); }
+        [&](const std::string_view word) {
+            if (const IndexedWord* indexed_word = FindWord(word)) {
+                const double word_weight = GetWordWeight<Ranking>(*indexed_word, word);
+                ForEachPosting(*indexed_word, [&](int ordinal, double term_freq) { updater(ordinal, term_freq, word_weight); });
+            }
+        }
     );
-
-    auto document_to_relevance = cm_document_to_relevance.BuildOrdinaryMap();
-
-    std::for_each(
+    ForEach(
         std::execution::par,
-        query.minus_words.begin(), query.minus_words.end(),
-        [&](const std::string_view word) {
-            if (word_to_document_freqs_.count(word)) {
-                for (const auto [document_id, _] : word_to_document_freqs_.at(std::string(word))) {
-                    document_to_relevance.erase(document_id);
+        query.field_plus_words.begin(), query.field_plus_words.end(),
+        [&](const FieldWord& field_word) {
+            const IndexedWord* indexed_word = FindFieldWord(field_word.first, field_word.second);
+            if (indexed_word && !indexed_word->postings.empty()) {
+                const double word_weight = GetFieldWordWeight<Ranking>(*indexed_word, field_word.first, field_word.second);
+                for (const auto [ordinal, term_freq] : indexed_word->postings) {
+                    updater(ordinal, term_freq, word_weight);
                 }
             }
-    });
+        }
+    );
 
-    std::vector<Document> matched_documents;
-    for (const auto [document_id, relevance] : document_to_relevance) {
-        matched_documents.push_back({document_id, relevance, documents_.at(document_id).rating});
+    auto document_to_relevance = cm_document_to_relevance.BuildVector();
+
+    std::vector<const IndexedWord*> minus_indexed_words;
+    for (const std::string_view word : query.minus_words) {
+        minus_indexed_words.push_back(FindWord(word));
     }
+    std::vector<const Postings*> field_minus_postings;
+    for (const auto& [field, word] : query.field_minus_words) {
+        field_minus_postings.push_back(FindFieldPostings(field, word));
+    }
+    const auto has_minus_word = [&](const std::pair<int, double>& document) {
+        for (size_t i = 0; i < minus_indexed_words.size(); ++i) {
+            if (HasWord(minus_indexed_words[i], query.minus_words[i], document.first)) {
+                return true;
+            }
+        }
+        for (const Postings* postings : field_minus_postings) {
+            if (postings && postings->count(document.first) > 0) {
+                return true;
+            }
+        }
+        return false;
+    };
+    document_to_relevance.erase(
+        std::remove_if(document_to_relevance.begin(), document_to_relevance.end(), has_minus_word),
+        document_to_relevance.end());
 
-    return matched_documents;
+    return CollectDocuments(query, document_to_relevance);
 }
 
+
+// Positions are read only for phrase queries and only for documents that passed the plus
+// and minus words: decoding them for every candidate of a term query costs more than the search
+template <typename DocumentToRelevance>
+std::vector<Document> SearchServer::CollectDocuments(const Query& query, const DocumentToRelevance& document_to_relevance) const {
+    std::vector<Document> matched_documents;
+    matched_documents.reserve(document_to_relevance.size());
+    for (const auto& [ordinal, relevance] : document_to_relevance) {
+        const auto& document_data = documents_[ordinal];
+        if (query.phrases.empty()) {
+            matched_documents.push_back({document_data.id, relevance, document_data.rating});
+        } else if (MatchPhrases(query, ordinal)) {
+            matched_documents.push_back({document_data.id, relevance * ComputeProximityFactor(query, ordinal), document_data.rating});
+        }
+    }
+    return matched_documents;
+}
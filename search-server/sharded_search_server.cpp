@@ -0,0 +1,97 @@
+#include "sharded_search_server.h"
+
+ShardedSearchServer::ShardedSearchServer(std::string_view stop_words_text, size_t shard_count)
+    : ShardedSearchServer(SplitIntoWordsView(stop_words_text), shard_count) {
+}
+
+ShardedSearchServer::ShardedSearchServer(const std::string& stop_words_text, size_t shard_count)
+    : ShardedSearchServer(std::string_view(stop_words_text), shard_count) {
+}
+
+void ShardedSearchServer::EnablePositionalIndex() {
+    ConfigureShards([](SearchServer& shard) { shard.EnablePositionalIndex(); });
+}
+
+void ShardedSearchServer::EnableQuantizedTermFrequencies() {
+    ConfigureShards([](SearchServer& shard) { shard.EnableQuantizedTermFrequencies(); });
+}
+
+void ShardedSearchServer::AddField(std::string_view name, double weight) {
+    ConfigureShards([&](SearchServer& shard) { shard.AddField(name, weight); });
+    field_names_.emplace_back(name);
+}
+
+void ShardedSearchServer::AddDocument(int document_id, std::string_view document, DocumentStatus status, const std::vector<int>& ratings) {
+    AddShardDocument(document_id, document, status, ratings);
+}
+
+void ShardedSearchServer::AddDocument(int document_id, const std::vector<DocumentField>& fields, DocumentStatus status, const std::vector<int>& ratings) {
+    AddShardDocument(document_id, fields, status, ratings);
+}
+
+void ShardedSearchServer::RemoveDocument(int document_id) {
+    RemoveDocument(std::execution::seq, document_id);
+}
+
+std::set<int>::const_iterator ShardedSearchServer::begin() const {
+    return document_ids_.begin();
+}
+
+std::set<int>::const_iterator ShardedSearchServer::end() const {
+    return document_ids_.end();
+}
+
+void ShardedSearchServer::SetExecutor(ThreadPool* executor) {
+    executor_ = executor;
+}
+
+void ShardedSearchServer::SetShardExecutor(size_t index, ThreadPool* executor) {
+    shard_executors_.at(index) = executor;
+    shards_[index].SetExecutor(executor);
+}
+
+int ShardedSearchServer::GetDocumentCount() const {
+    return statistics_.GetDocumentCount();
+}
+
+size_t ShardedSearchServer::GetShardCount() const {
+    return shards_.size();
+}
+
+const SearchServer& ShardedSearchServer::GetShard(size_t index) const {
+    return shards_.at(index);
+}
+
+const std::map<std::string_view, double>& ShardedSearchServer::GetWordFrequencies(int document_id) const {
+    return GetDocumentShard(document_id).GetWordFrequencies(document_id);
+}
+
+std::tuple<std::vector<std::string_view>, DocumentStatus> ShardedSearchServer::MatchDocument(std::string_view raw_query, int document_id) const {
+    return GetDocumentShard(document_id).MatchDocument(raw_query, document_id);
+}
+
+std::tuple<std::vector<std::string_view>, DocumentStatus> ShardedSearchServer::MatchDocument(std::execution::sequenced_policy policy, std::string_view raw_query, int document_id) const {
+    return GetDocumentShard(document_id).MatchDocument(policy, raw_query, document_id);
+}
+
+std::tuple<std::vector<std::string_view>, DocumentStatus> ShardedSearchServer::MatchDocument(std::execution::parallel_policy policy, std::string_view raw_query, int document_id) const {
+    return GetDocumentShard(document_id).MatchDocument(policy, raw_query, document_id);
+}
+
+void ShardedSearchServer::ConnectShards() {
+    for (SearchServer& shard : shards_) {
+        shard.SetCorpusStatistics(&statistics_);
+    }
+}
+
+size_t ShardedSearchServer::GetShardIndex(int document_id) const {
+    return std::hash<int>{}(document_id) % shards_.size();
+}
+
+SearchServer& ShardedSearchServer::GetDocumentShard(int document_id) {
+    return shards_[GetShardIndex(document_id)];
+}
+
+const SearchServer& ShardedSearchServer::GetDocumentShard(int document_id) const {
+    return shards_[GetShardIndex(document_id)];
+}
@@ -0,0 +1,298 @@
+#pragma once
+#include "search_server.h"
+#include "corpus_statistics.h"
+#include "thread_pool.h"
+
+#include <string>
+#include <vector>
+#include <set>
+#include <algorithm>
+#include <execution>
+#include <exception>
+#include <stdexcept>
+#include <mutex>
+#include <utility>
+#include <future>
+
+// Hash-partitions documents across independent SearchServer shards.
+// Queries are scattered to all shards and per-shard top documents are merged.
+// IDF is computed from statistics shared by all shards, so results match a single server
+class ShardedSearchServer {
+public:
+    template <typename StringContainer>
+    ShardedSearchServer(const StringContainer& stop_words, size_t shard_count);
+    ShardedSearchServer(const std::string& stop_words_text, size_t shard_count);
+    ShardedSearchServer(std::string_view stop_words_text, size_t shard_count);
+
+    // Shards keep a pointer to statistics_
+    ShardedSearchServer(const ShardedSearchServer&) = delete;
+    ShardedSearchServer& operator=(const ShardedSearchServer&) = delete;
+
+    void EnablePositionalIndex();
+    void EnableQuantizedTermFrequencies();
+    void AddField(std::string_view name, double weight = 1.0);
+
+    void AddDocument(int document_id, std::string_view document, DocumentStatus status, const std::vector<int>& ratings);
+    void AddDocument(int document_id, const std::vector<DocumentField>& fields, DocumentStatus status, const std::vector<int>& ratings);
+
+    template <typename ExecutionPolicy>
+    void RemoveDocument(ExecutionPolicy&& policy, int document_id);
+    void RemoveDocument(int document_id);
+
+    template <typename Ranking = TfIdfRanking, typename DocumentPredicate>
+    std::vector<Document> FindTopDocuments(std::string_view raw_query, DocumentPredicate document_predicate) const;
+    template <typename Ranking = TfIdfRanking>
+    std::vector<Document> FindTopDocuments(std::string_view raw_query, DocumentStatus status) const;
+    template <typename Ranking = TfIdfRanking>
+    std::vector<Document> FindTopDocuments(std::string_view raw_query) const;
+
+    template <typename Ranking = TfIdfRanking, typename ExecutionPolicy, typename DocumentPredicate>
+    std::vector<Document> FindTopDocuments(ExecutionPolicy&& policy, std::string_view raw_query, DocumentPredicate document_predicate) const;
+
+    template <typename Ranking = TfIdfRanking, typename ExecutionPolicy>
+    std::vector<Document> FindTopDocuments(ExecutionPolicy&& policy, std::string_view raw_query, DocumentStatus status) const;
+
+    template <typename Ranking = TfIdfRanking, typename ExecutionPolicy>
+    std::vector<Document> FindTopDocuments(ExecutionPolicy&& policy, std::string_view raw_query) const;
+
+    template <typename Ranking = TfIdfRanking, typename DocumentPredicate>
+    DocumentPage FindDocumentsPage(std::string_view raw_query, DocumentPredicate document_predicate, size_t page_size,
+                                   const std::optional<SearchCursor>& after = std::nullopt) const;
+    template <typename Ranking = TfIdfRanking>
+    DocumentPage FindDocumentsPage(std::string_view raw_query, DocumentStatus status, size_t page_size,
+                                   const std::optional<SearchCursor>& after = std::nullopt) const;
+
+    template <typename Ranking = TfIdfRanking, typename ExecutionPolicy, typename DocumentPredicate>
+    DocumentPage FindDocumentsPage(ExecutionPolicy&& policy, std::string_view raw_query, DocumentPredicate document_predicate, size_t page_size,
+                                   const std::optional<SearchCursor>& after = std::nullopt) const;
+
+    std::set<int>::const_iterator begin() const;
+    std::set<int>::const_iterator end() const;
+
+    // Executor used to scatter queries to shards that have no executor of their own
+    void SetExecutor(ThreadPool* executor);
+
+    // Shard executor runs the shard's searches and ingestion. A pool pinned to the CPUs
+    // of one NUMA node keeps the shard's threads and, by first touch, its memory on that node
+    void SetShardExecutor(size_t index, ThreadPool* executor);
+
+    int GetDocumentCount() const;
+    size_t GetShardCount() const;
+    const SearchServer& GetShard(size_t index) const;
+
+    const std::map<std::string_view, double>& GetWordFrequencies(int document_id) const;
+
+    std::tuple<std::vector<std::string_view>, DocumentStatus> MatchDocument(std::string_view raw_query, int document_id) const;
+    std::tuple<std::vector<std::string_view>, DocumentStatus> MatchDocument(std::execution::sequenced_policy, std::string_view raw_query, int document_id) const;
+    std::tuple<std::vector<std::string_view>, DocumentStatus> MatchDocument(std::execution::parallel_policy, std::string_view raw_query, int document_id) const;
+
+private:
+    CorpusStatistics statistics_;
+    std::vector<SearchServer> shards_;
+    std::vector<std::string> field_names_;
+    std::vector<ThreadPool*> shard_executors_;
+    ThreadPool* executor_ = nullptr;
+    std::set<int> document_ids_;
+
+    void ConnectShards();
+
+    // Documents may sit in any shard, so their absence is checked before the first shard is
+    // changed; shards are configured alike, so a setting the first shard accepts fits them all
+    template <typename Function>
+    void ConfigureShards(Function function);
+
+    template <typename ExecutionPolicy, typename Function>
+    void ForEachShard(ExecutionPolicy&& policy, Function function) const;
+
+    // Content is the document text or its fields
+    template <typename Content>
+    void AddShardDocument(int document_id, const Content& content, DocumentStatus status, const std::vector<int>& ratings);
+
+    size_t GetShardIndex(int document_id) const;
+    SearchServer& GetDocumentShard(int document_id);
+    const SearchServer& GetDocumentShard(int document_id) const;
+};
+
+template <typename StringContainer>
+ShardedSearchServer::ShardedSearchServer(const StringContainer& stop_words, size_t shard_count) {
+    using namespace std::string_literals;
+    if (shard_count == 0) {
+        throw std::invalid_argument("Shard count must be positive"s);
+    }
+    shards_.reserve(shard_count);
+    for (size_t i = 0; i < shard_count; ++i) {
+        shards_.emplace_back(stop_words);
+    }
+    shard_executors_.resize(shard_count, nullptr);
+    ConnectShards();
+}
+
+template <typename Function>
+void ShardedSearchServer::ConfigureShards(Function function) {
+    using namespace std::string_literals;
+    if (!document_ids_.empty()) {
+        throw std::logic_error("Shards must be configured before adding documents"s);
+    }
+    for (SearchServer& shard : shards_) {
+        function(shard);
+    }
+}
+
+template <typename Content>
+void ShardedSearchServer::AddShardDocument(int document_id, const Content& content, DocumentStatus status, const std::vector<int>& ratings) {
+    SearchServer& shard = GetDocumentShard(document_id);
+    if (ThreadPool* executor = shard_executors_[GetShardIndex(document_id)]) {
+        executor->Wait(executor->Submit([&] { shard.AddDocument(document_id, content, status, ratings); }));
+    } else {
+        shard.AddDocument(document_id, content, status, ratings);
+    }
+    statistics_.AddDocument(shard.GetWordFrequencies(document_id), shard.GetDocumentLength(document_id));
+    if constexpr (std::is_same_v<Content, std::vector<DocumentField>>) {
+        for (const std::string& field : field_names_) {
+            statistics_.AddFieldWords(field, shard.GetFieldWordFrequencies(field, document_id));
+        }
+    }
+    document_ids_.insert(document_id);
+}
+
+template <typename ExecutionPolicy, typename Function>
+void ShardedSearchServer::ForEachShard(ExecutionPolicy&&, Function function) const {
+    if constexpr (!std::is_same_v<std::decay_t<ExecutionPolicy>, std::execution::parallel_policy>) {
+        for (size_t index = 0; index < shards_.size(); ++index) {
+            function(index);
+        }
+    } else {
+        // An exception escaping std::for_each(par) calls std::terminate, so shard errors,
+        // e.g. an invalid query, are kept and the first one is rethrown after the join
+        std::mutex exception_mutex;
+        std::exception_ptr exception;
+        const auto run_shard = [&](size_t index) {
+            try {
+                function(index);
+            } catch (...) {
+                std::lock_guard guard(exception_mutex);
+                if (!exception) {
+                    exception = std::current_exception();
+                }
+            }
+        };
+
+        // Pinned shards are waited for with ThreadPool::Wait: called from a task of the same pool
+        // it runs pending tasks and does not deadlock, elsewhere it blocks and the shard runs on
+        // its pinned workers
+        std::vector<std::pair<ThreadPool*, std::future<void>>> pinned_runs;
+        std::vector<size_t> free_shards;
+        for (size_t index = 0; index < shards_.size(); ++index) {
+            if (ThreadPool* shard_executor = shard_executors_[index]) {
+                pinned_runs.emplace_back(shard_executor, shard_executor->Submit([&run_shard, index] { run_shard(index); }));
+            } else {
+                free_shards.push_back(index);
+            }
+        }
+
+        if (executor_) {
+            executor_->ForEach(free_shards.begin(), free_shards.end(), run_shard);
+        } else {
+            std::for_each(std::execution::par, free_shards.begin(), free_shards.end(), run_shard);
+        }
+
+        for (auto& [shard_executor, run] : pinned_runs) {
+            shard_executor->Wait(std::move(run));
+        }
+        if (exception) {
+            std::rethrow_exception(exception);
+        }
+    }
+}
+
+template <typename ExecutionPolicy>
+void ShardedSearchServer::RemoveDocument(ExecutionPolicy&& policy, int document_id) {
+    if (document_ids_.count(document_id) == 0) {
+        return;
+    }
+    SearchServer& shard = GetDocumentShard(document_id);
+    statistics_.RemoveDocument(shard.GetWordFrequencies(document_id), shard.GetDocumentLength(document_id));
+    for (const std::string& field : field_names_) {
+        statistics_.RemoveFieldWords(field, shard.GetFieldWordFrequencies(field, document_id));
+    }
+    shard.RemoveDocument(policy, document_id);
+    document_ids_.erase(document_id);
+}
+
+template <typename Ranking, typename DocumentPredicate>
+std::vector<Document> ShardedSearchServer::FindTopDocuments(std::string_view raw_query, DocumentPredicate document_predicate) const {
+    return FindTopDocuments<Ranking>(std::execution::seq, raw_query, document_predicate);
+}
+
+template <typename Ranking>
+std::vector<Document> ShardedSearchServer::FindTopDocuments(std::string_view raw_query, DocumentStatus status) const {
+    return FindTopDocuments<Ranking>(std::execution::seq, raw_query, status);
+}
+
+template <typename Ranking>
+std::vector<Document> ShardedSearchServer::FindTopDocuments(std::string_view raw_query) const {
+    return FindTopDocuments<Ranking>(std::execution::seq, raw_query, DocumentStatus::ACTUAL);
+}
+
+template <typename Ranking, typename ExecutionPolicy, typename DocumentPredicate>
+std::vector<Document> ShardedSearchServer::FindTopDocuments(ExecutionPolicy&& policy, std::string_view raw_query, DocumentPredicate document_predicate) const {
+    // Shards are searched in parallel with each other, so every shard searches sequentially
+    std::vector<std::vector<Document>> shard_documents(shards_.size());
+    ForEachShard(policy, [&](size_t index) {
+        shard_documents[index] = shards_[index].template FindTopDocuments<Ranking>(std::execution::seq, raw_query, document_predicate);
+    });
+
+    std::vector<Document> matched_documents;
+    for (const auto& documents : shard_documents) {
+        matched_documents.insert(matched_documents.end(), documents.begin(), documents.end());
+    }
+
+    // The order of the shards' partial_sort, so the merged top is the single server top
+    sort(matched_documents.begin(), matched_documents.end(), IsRankedBefore);
+    if (matched_documents.size() > MAX_RESULT_DOCUMENT_COUNT) {
+        matched_documents.resize(MAX_RESULT_DOCUMENT_COUNT);
+    }
+    return matched_documents;
+}
+
+template <typename Ranking, typename ExecutionPolicy>
+std::vector<Document> ShardedSearchServer::FindTopDocuments(ExecutionPolicy&& policy, std::string_view raw_query, DocumentStatus status) const {
+    return FindTopDocuments<Ranking>(policy, raw_query, [status](int document_id, DocumentStatus document_status, int rating) {
+        return document_status == status;
+    });
+}
+
+template <typename Ranking, typename ExecutionPolicy>
+std::vector<Document> ShardedSearchServer::FindTopDocuments(ExecutionPolicy&& policy, std::string_view raw_query) const {
+    return FindTopDocuments<Ranking>(policy, raw_query, DocumentStatus::ACTUAL);
+}
+
+template <typename Ranking, typename DocumentPredicate>
+DocumentPage ShardedSearchServer::FindDocumentsPage(std::string_view raw_query, DocumentPredicate document_predicate, size_t page_size,
+                                                    const std::optional<SearchCursor>& after) const {
+    return FindDocumentsPage<Ranking>(std::execution::seq, raw_query, document_predicate, page_size, after);
+}
+
+template <typename Ranking>
+DocumentPage ShardedSearchServer::FindDocumentsPage(std::string_view raw_query, DocumentStatus status, size_t page_size,
+                                                    const std::optional<SearchCursor>& after) const {
+    return FindDocumentsPage<Ranking>(raw_query, [status](int document_id, DocumentStatus document_status, int rating) {
+        return document_status == status;
+    }, page_size, after);
+}
+
+template <typename Ranking, typename ExecutionPolicy, typename DocumentPredicate>
+DocumentPage ShardedSearchServer::FindDocumentsPage(ExecutionPolicy&& policy, std::string_view raw_query, DocumentPredicate document_predicate, size_t page_size,
+                                                    const std::optional<SearchCursor>& after) const {
+    // One extra document per shard shows whether the merged page has a successor
+    std::vector<DocumentPage> shard_pages(shards_.size());
+    ForEachShard(policy, [&](size_t index) {
+        shard_pages[index] = shards_[index].template FindDocumentsPage<Ranking>(std::execution::seq, raw_query, document_predicate, page_size + 1, after);
+    });
+
+    std::vector<Document> documents;
+    for (const auto& page : shard_pages) {
+        documents.insert(documents.end(), page.documents.begin(), page.documents.end());
+    }
+    return MakeDocumentPage(documents, page_size, after);
+}
@@ -0,0 +1,169 @@
+#include "term_dictionary.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace {
+
+void WriteVarint(std::vector<uint8_t>& data, uint32_t value) {
+    while (value >= 0x80) {
+        data.push_back(static_cast<uint8_t>(value | 0x80));
+        value >>= 7;
+    }
+    data.push_back(static_cast<uint8_t>(value));
+}
+
+uint32_t ReadVarint(const std::vector<uint8_t>& data, size_t& offset) {
+    uint32_t value = 0;
+    int shift = 0;
+    while (data[offset] & 0x80) {
+        value |= static_cast<uint32_t>(data[offset++] & 0x7F) << shift;
+        shift += 7;
+    }
+    return value | static_cast<uint32_t>(data[offset++]) << shift;
+}
+
+size_t GetSharedPrefixLength(std::string_view lhs, std::string_view rhs) {
+    return std::mismatch(lhs.begin(), lhs.begin() + std::min(lhs.size(), rhs.size()), rhs.begin()).first - lhs.begin();
+}
+
+} // namespace
+
+int TermDictionary::Find(std::string_view term) const {
+    const auto pending_it = pending_.find(term);
+    if (pending_it != pending_.end()) {
+        return pending_it->second;
+    }
+    const Cursor cursor = LowerBound(term);
+    return !IsEnd(cursor) && cursor.term == term ? sorted_ids_[cursor.index] : NO_TERM;
+}
+
+int TermDictionary::Add(std::string_view term) {
+    const int found_id = Find(term);
+    if (found_id != NO_TERM) {
+        return found_id;
+    }
+    const int id = static_cast<int>(terms_.size());
+    const std::string_view stored_term = StoreTerm(term);
+    terms_.push_back(stored_term);
+    pending_.emplace(stored_term, id);
+    if (pending_.size() > std::max(MIN_PENDING_COUNT, sorted_ids_.size() / 8)) {
+        Rebuild();
+    }
+    return id;
+}
+
+std::string_view TermDictionary::GetTerm(int id) const {
+    return terms_[id];
+}
+
+size_t TermDictionary::size() const {
+    return terms_.size();
+}
+
+TermDictionary::Cursor TermDictionary::LowerBound(std::string_view term) const {
+    Cursor cursor;
+    if (sorted_ids_.empty()) {
+        return cursor;
+    }
+    // The last block whose head is not greater than the term holds the answer or ends before it
+    size_t left = 0;
+    size_t right = block_offsets_.size();
+    while (right - left > 1) {
+        const size_t middle = (left + right) / 2;
+        if (GetBlockHead(middle) <= term) {
+            left = middle;
+        } else {
+            right = middle;
+        }
+    }
+    cursor.index = left * BLOCK_SIZE;
+    cursor.offset = block_offsets_[left];
+    Decode(cursor);
+    while (!IsEnd(cursor) && std::string_view(cursor.term) < term) {
+        Next(cursor);
+    }
+    return cursor;
+}
+
+bool TermDictionary::IsEnd(const Cursor& cursor) const {
+    return cursor.index >= sorted_ids_.size();
+}
+
+void TermDictionary::Next(Cursor& cursor) const {
+    if (++cursor.index < sorted_ids_.size()) {
+        Decode(cursor);
+    }
+}
+
+void TermDictionary::Decode(Cursor& cursor) const {
+    const uint32_t shared_length = ReadVarint(blocks_, cursor.offset);
+    const uint32_t suffix_length = ReadVarint(blocks_, cursor.offset);
+    cursor.term.resize(shared_length);
+    cursor.term.append(reinterpret_cast<const char*>(blocks_.data() + cursor.offset), suffix_length);
+    cursor.offset += suffix_length;
+}
+
+std::string_view TermDictionary::GetBlockHead(size_t block) const {
+    size_t offset = block_offsets_[block];
+    ReadVarint(blocks_, offset);
+    const uint32_t length = ReadVarint(blocks_, offset);
+    return {reinterpret_cast<const char*>(blocks_.data() + offset), length};
+}
+
+std::string_view TermDictionary::StoreTerm(std::string_view term) {
+    if (term.empty()) {
+        return {};
+    }
+    if (term.size() > chunk_free_size_) {
+        // A term longer than a chunk gets a chunk of its own
+        const size_t chunk_size = std::max(CHUNK_SIZE, term.size());
+        chunks_.push_back(std::make_unique<char[]>(chunk_size));
+        chunk_free_ = chunks_.back().get();
+        chunk_free_size_ = chunk_size;
+    }
+    char* const data = chunk_free_;
+    std::memcpy(data, term.data(), term.size());
+    chunk_free_ += term.size();
+    chunk_free_size_ -= term.size();
+    return {data, term.size()};
+}
+
+// Merges the pending terms into the sorted ones and encodes the blocks again
+void TermDictionary::Rebuild() {
+    std::vector<int> sorted_ids;
+    sorted_ids.reserve(sorted_ids_.size() + pending_.size());
+    auto pending_it = pending_.begin();
+    for (const int id : sorted_ids_) {
+        for (; pending_it != pending_.end() && pending_it->first < terms_[id]; ++pending_it) {
+            sorted_ids.push_back(pending_it->second);
+        }
+        sorted_ids.push_back(id);
+    }
+    for (; pending_it != pending_.end(); ++pending_it) {
+        sorted_ids.push_back(pending_it->second);
+    }
+
+    std::vector<uint8_t> blocks;
+    std::vector<uint32_t> block_offsets;
+    std::string_view previous;
+    for (size_t i = 0; i < sorted_ids.size(); ++i) {
+        const std::string_view term = terms_[sorted_ids[i]];
+        size_t shared_length = 0;
+        if (i % BLOCK_SIZE == 0) {
+            block_offsets.push_back(static_cast<uint32_t>(blocks.size()));
+        } else {
+            shared_length = GetSharedPrefixLength(previous, term);
+        }
+        WriteVarint(blocks, static_cast<uint32_t>(shared_length));
+        WriteVarint(blocks, static_cast<uint32_t>(term.size() - shared_length));
+        blocks.insert(blocks.end(), term.begin() + shared_length, term.end());
+        previous = term;
+    }
+    blocks.shrink_to_fit();
+
+    sorted_ids_ = std::move(sorted_ids);
+    blocks_ = std::move(blocks);
+    block_offsets_ = std::move(block_offsets);
+    pending_.clear();
+}
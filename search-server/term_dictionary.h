@@ -0,0 +1,98 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Dictionary of indexed words. Terms get dense ids in the order they are added and are
+// stored once in chunks that never move, so string_views of them stay valid while the
+// dictionary lives. Sorted lookup goes through front-coded blocks: the first term of a
+// block is stored whole, the next ones as the length of the prefix shared with the
+// previous term and the rest, so a lookup decodes one short contiguous block after a
+// binary search over block heads. Terms added since the blocks were built wait in a
+// small sorted delta, which is merged once it outgrows a share of the dictionary
+class TermDictionary {
+public:
+    static constexpr int NO_TERM = -1;
+
+    // Owners keep string_views of the terms, so the dictionary moves but is never copied
+    TermDictionary() = default;
+    TermDictionary(const TermDictionary&) = delete;
+    TermDictionary& operator=(const TermDictionary&) = delete;
+    TermDictionary(TermDictionary&&) = default;
+    TermDictionary& operator=(TermDictionary&&) = default;
+
+    // Id of the term or NO_TERM
+    int Find(std::string_view term) const;
+    // Id of the term, an unknown term gets the next id
+    int Add(std::string_view term);
+    std::string_view GetTerm(int id) const;
+    size_t size() const;
+
+    // Calls function(id, term) for the terms that start with prefix in lexicographic order
+    // until it returns false
+    template <typename Function>
+    void ForEachWithPrefix(std::string_view prefix, Function function) const;
+
+private:
+    static constexpr size_t BLOCK_SIZE = 16;
+    static constexpr size_t CHUNK_SIZE = 64 * 1024;
+    static constexpr size_t MIN_PENDING_COUNT = 256;
+
+    std::vector<std::unique_ptr<char[]>> chunks_;
+    char* chunk_free_ = nullptr;
+    size_t chunk_free_size_ = 0;
+    std::vector<std::string_view> terms_;
+
+    // Entries are varint shared prefix length, varint suffix length and the suffix bytes
+    std::vector<uint8_t> blocks_;
+    std::vector<uint32_t> block_offsets_;
+    std::vector<int> sorted_ids_;
+
+    std::map<std::string_view, int> pending_;
+
+    // A sorted position with its term decoded, offset is the next entry in blocks_
+    struct Cursor {
+        size_t index = 0;
+        size_t offset = 0;
+        std::string term;
+    };
+
+    // First term not less than the given one
+    Cursor LowerBound(std::string_view term) const;
+    bool IsEnd(const Cursor& cursor) const;
+    void Next(Cursor& cursor) const;
+    void Decode(Cursor& cursor) const;
+    std::string_view GetBlockHead(size_t block) const;
+
+    std::string_view StoreTerm(std::string_view term);
+    void Rebuild();
+};
+
+template <typename Function>
+void TermDictionary::ForEachWithPrefix(std::string_view prefix, Function function) const {
+    Cursor cursor = LowerBound(prefix);
+    auto pending_it = pending_.lower_bound(prefix);
+    while (true) {
+        const bool has_sorted = !IsEnd(cursor) && std::string_view(cursor.term).substr(0, prefix.size()) == prefix;
+        const bool has_pending = pending_it != pending_.end() && pending_it->first.substr(0, prefix.size()) == prefix;
+        if (!has_sorted && !has_pending) {
+            return;
+        }
+        int id;
+        if (has_sorted && (!has_pending || std::string_view(cursor.term) < pending_it->first)) {
+            id = sorted_ids_[cursor.index];
+            Next(cursor);
+        } else {
+            id = pending_it->second;
+            ++pending_it;
+        }
+        if (!function(id, terms_[id])) {
+            return;
+        }
+    }
+}
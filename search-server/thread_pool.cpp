@@ -0,0 +1,165 @@
+#include "thread_pool.h"
+
+#include <stdexcept>
+#include <string>
+#include <system_error>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+namespace {
+
+struct WorkerContext {
+    const ThreadPool* pool = nullptr;
+    size_t index = 0;
+};
+
+thread_local WorkerContext current_worker;
+
+}
+
+ThreadPool::ThreadPool(size_t thread_count, const std::vector<int>& cpu_ids) {
+    using namespace std::string_literals;
+    if (thread_count == 0) {
+        throw std::invalid_argument("Thread count must be positive"s);
+    }
+    queues_.reserve(thread_count);
+    for (size_t i = 0; i < thread_count; ++i) {
+        queues_.push_back(std::make_unique<TaskQueue>());
+    }
+    workers_.reserve(thread_count);
+    try {
+        for (size_t i = 0; i < thread_count; ++i) {
+            workers_.emplace_back([this, i] { RunWorker(i); });
+            if (!cpu_ids.empty()) {
+                PinWorker(i, cpu_ids[i % cpu_ids.size()]);
+            }
+        }
+    } catch (...) {
+        // The destructor does not run for a pool that failed to construct
+        Stop();
+        throw;
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    Stop();
+}
+
+void ThreadPool::Stop() {
+    {
+        std::lock_guard guard(sleep_mutex_);
+        stop_ = true;
+    }
+    wake_up_.notify_all();
+    for (auto& worker : workers_) {
+        worker.join();
+    }
+}
+
+size_t ThreadPool::GetThreadCount() const {
+    return workers_.size();
+}
+
+void ThreadPool::Push(Task task) {
+    // Workers push to their own deque, which keeps nested tasks local,
+    // external threads spread tasks round-robin
+    size_t index = GetCurrentWorkerIndex();
+    if (index == queues_.size()) {
+        index = next_queue_++ % queues_.size();
+    }
+    bool has_waiters = false;
+    {
+        std::lock_guard guard(sleep_mutex_);
+        ++queued_count_;
+        has_waiters = waiting_count_ > 0;
+    }
+    {
+        std::lock_guard guard(queues_[index]->mutex);
+        queues_[index]->tasks.push_back(std::move(task));
+    }
+    wake_up_.notify_one();
+    if (has_waiters) {
+        waiter_wake_up_.notify_all();
+    }
+}
+
+void ThreadPool::NotifyWaiters() {
+    {
+        std::lock_guard guard(sleep_mutex_);
+        if (waiting_count_ == 0) {
+            return;
+        }
+    }
+    waiter_wake_up_.notify_all();
+}
+
+bool ThreadPool::TryRunTask() {
+    const size_t own_index = GetCurrentWorkerIndex();
+    Task task;
+
+    if (own_index < queues_.size()) {
+        TaskQueue& own = *queues_[own_index];
+        std::lock_guard guard(own.mutex);
+        if (!own.tasks.empty()) {
+            task = std::move(own.tasks.back());
+            own.tasks.pop_back();
+        }
+    }
+
+    const size_t start = own_index < queues_.size() ? own_index + 1 : 0;
+    for (size_t i = 0; !task && i < queues_.size(); ++i) {
+        TaskQueue& victim = *queues_[(start + i) % queues_.size()];
+        std::lock_guard guard(victim.mutex);
+        if (!victim.tasks.empty()) {
+            task = std::move(victim.tasks.front());
+            victim.tasks.pop_front();
+        }
+    }
+
+    if (!task) {
+        return false;
+    }
+    --queued_count_;
+    task();
+    return true;
+}
+
+void ThreadPool::RunWorker(size_t index) {
+    current_worker = {this, index};
+    while (true) {
+        if (TryRunTask()) {
+            continue;
+        }
+        std::unique_lock lock(sleep_mutex_);
+        wake_up_.wait(lock, [this] { return stop_ || queued_count_ > 0; });
+        if (stop_ && queued_count_ == 0) {
+            return;
+        }
+    }
+}
+
+void ThreadPool::PinWorker(size_t index, int cpu_id) {
+    using namespace std::string_literals;
+#ifdef __linux__
+    if (cpu_id < 0 || cpu_id >= CPU_SETSIZE) {
+        throw std::invalid_argument("Invalid CPU id "s + std::to_string(cpu_id));
+    }
+    cpu_set_t cpu_set;
+    CPU_ZERO(&cpu_set);
+    CPU_SET(cpu_id, &cpu_set);
+    if (const int error = pthread_setaffinity_np(workers_[index].native_handle(), sizeof(cpu_set), &cpu_set)) {
+        throw std::system_error(error, std::generic_category(), "Cannot pin worker to CPU "s + std::to_string(cpu_id));
+    }
+#else
+    (void)index;
+    (void)cpu_id;
+    throw std::invalid_argument("Pinning workers to CPUs is supported only on Linux"s);
+#endif
+}
+
+size_t ThreadPool::GetCurrentWorkerIndex() const {
+    return current_worker.pool == this ? current_worker.index : queues_.size();
+}
@@ -0,0 +1,168 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <future>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+// Work-stealing executor. Every worker owns a task deque: it takes its own tasks
+// from the back and steals from the front of other deques when its own is empty.
+// ParallelFor and ForEach are fork-join: the calling thread executes pending tasks
+// while waiting and sleeps when there are none, so nested calls from inside pool
+// tasks neither deadlock nor create extra threads or busy-wait. Wait helps the same
+// way on a worker of the pool only, other threads leave the task to the workers
+class ThreadPool {
+public:
+    // Workers are pinned round-robin to cpu_ids, empty cpu_ids means no pinning.
+    // Throws if a worker cannot be pinned or pinning is not supported (non-Linux)
+    explicit ThreadPool(size_t thread_count, const std::vector<int>& cpu_ids = {});
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    size_t GetThreadCount() const;
+
+    // Blocking on the returned future with get() inside a pool task may deadlock, use Wait
+    template <typename Function>
+    std::future<std::invoke_result_t<Function>> Submit(Function function);
+
+    // future.get() for a future of Submit. Called from a worker of this pool, it runs pending
+    // tasks while the result is not ready; any other thread blocks, so the task runs on a
+    // worker, e.g. on the CPUs the pool is pinned to
+    template <typename Result>
+    Result Wait(std::future<Result> future);
+
+    template <typename Function>
+    void ParallelFor(size_t first, size_t last, Function function);
+
+    template <typename Iterator, typename Function>
+    void ForEach(Iterator first, Iterator last, Function function);
+
+private:
+    using Task = std::function<void()>;
+
+    struct alignas(64) TaskQueue {
+        std::mutex mutex;
+        std::deque<Task> tasks;
+    };
+
+    std::vector<std::unique_ptr<TaskQueue>> queues_;
+    std::vector<std::thread> workers_;
+
+    // Workers sleep on wake_up_, threads waiting for a join sleep on waiter_wake_up_,
+    // which is signalled by new tasks and finished joins
+    std::mutex sleep_mutex_;
+    std::condition_variable wake_up_;
+    std::condition_variable waiter_wake_up_;
+    std::atomic<size_t> queued_count_ = 0;
+    std::atomic<size_t> next_queue_ = 0;
+    size_t waiting_count_ = 0;
+    bool stop_ = false;
+
+    void Push(Task task);
+    bool TryRunTask();
+    void NotifyWaiters();
+    template <typename Predicate>
+    void HelpUntil(Predicate is_done);
+    void RunWorker(size_t index);
+    void PinWorker(size_t index, int cpu_id);
+    void Stop();
+
+    size_t GetCurrentWorkerIndex() const;
+};
+
+template <typename Function>
+std::future<std::invoke_result_t<Function>> ThreadPool::Submit(Function function) {
+    auto task = std::make_shared<std::packaged_task<std::invoke_result_t<Function>()>>(std::move(function));
+    auto result = task->get_future();
+    Push([this, task] {
+        (*task)();
+        NotifyWaiters();
+    });
+    return result;
+}
+
+template <typename Result>
+Result ThreadPool::Wait(std::future<Result> future) {
+    if (GetCurrentWorkerIndex() < queues_.size()) {
+        HelpUntil([&future] { return future.wait_for(std::chrono::seconds(0)) == std::future_status::ready; });
+    }
+    return future.get();
+}
+
+template <typename Predicate>
+void ThreadPool::HelpUntil(Predicate is_done) {
+    while (!is_done()) {
+        if (TryRunTask()) {
+            continue;
+        }
+        std::unique_lock lock(sleep_mutex_);
+        ++waiting_count_;
+        waiter_wake_up_.wait(lock, [&] { return is_done() || queued_count_ > 0; });
+        --waiting_count_;
+    }
+}
+
+template <typename Function>
+void ThreadPool::ParallelFor(size_t first, size_t last, Function function) {
+    if (first >= last) {
+        return;
+    }
+    // A few chunks per worker leave room for stealing when chunks are uneven
+    const size_t max_chunk_count = std::min(last - first, workers_.size() * 4 + 1);
+    const size_t chunk_size = (last - first + max_chunk_count - 1) / max_chunk_count;
+    const size_t chunk_count = (last - first + chunk_size - 1) / chunk_size;
+
+    struct Join {
+        std::atomic<size_t> remaining;
+        std::mutex mutex;
+        std::exception_ptr exception;
+    };
+    auto join = std::make_shared<Join>();
+    join->remaining = chunk_count;
+
+    auto run_chunk = [this, join, &function](size_t begin, size_t end) {
+        try {
+            for (size_t i = begin; i < end; ++i) {
+                function(i);
+            }
+        } catch (...) {
+            std::lock_guard guard(join->mutex);
+            if (!join->exception) {
+                join->exception = std::current_exception();
+            }
+        }
+        if (--join->remaining == 0) {
+            NotifyWaiters();
+        }
+    };
+
+    for (size_t begin = first + chunk_size; begin < last; begin += chunk_size) {
+        const size_t end = std::min(begin + chunk_size, last);
+        Push([run_chunk, begin, end] { run_chunk(begin, end); });
+    }
+    run_chunk(first, std::min(first + chunk_size, last));
+
+    HelpUntil([&join] { return join->remaining == 0; });
+    if (join->exception) {
+        std::rethrow_exception(join->exception);
+    }
+}
+
+template <typename Iterator, typename Function>
+void ThreadPool::ForEach(Iterator first, Iterator last, Function function) {
+    static_assert(std::is_base_of_v<std::random_access_iterator_tag, typename std::iterator_traits<Iterator>::iterator_category>,
+                  "ThreadPool::ForEach requires random access iterators");
+    ParallelFor(0, static_cast<size_t>(last - first), [first, &function](size_t i) { function(first[i]); });
+}
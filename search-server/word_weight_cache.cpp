@@ -0,0 +1,17 @@
+#include "word_weight_cache.h"
+
+WordWeightCache::WordWeightCache(const WordWeightCache&) noexcept {
+}
+
+WordWeightCache& WordWeightCache::operator=(const WordWeightCache&) noexcept {
+    for (auto& version : versions_) {
+        version.store(0, std::memory_order_relaxed);
+    }
+    return *this;
+}
+
+uint64_t WordWeightCache::NewVersion() {
+    // Zero marks an empty slot
+    static std::atomic<uint64_t> last_version = 0;
+    return ++last_version;
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include "ranking.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+
+// Word weights of TfIdfRanking and Bm25Ranking for one word, each computed once per corpus
+// version instead of once per query; other ranking policies are computed every time.
+// Lookups may run concurrently: a weight is stored before its version, and all threads
+// compute the same weight for the same version
+class WordWeightCache {
+public:
+    WordWeightCache() = default;
+    // A copy starts empty, its weights are recomputed on first use
+    WordWeightCache(const WordWeightCache&) noexcept;
+    WordWeightCache& operator=(const WordWeightCache&) noexcept;
+
+    // Versions are unique across all corpora in the process, so a weight cached for one
+    // corpus is never taken for another one with the same document counts
+    static uint64_t NewVersion();
+
+    template <typename Ranking, typename ComputeWeight>
+    double Get(uint64_t version, ComputeWeight compute_weight) const;
+
+private:
+    static constexpr size_t RANKING_COUNT = 2;
+
+    mutable std::atomic<uint64_t> versions_[RANKING_COUNT] = {};
+    mutable std::atomic<double> weights_[RANKING_COUNT] = {};
+
+    template <typename Ranking>
+    static constexpr int GetSlot() {
+        if constexpr (std::is_same_v<Ranking, TfIdfRanking>) {
+            return 0;
+        } else if constexpr (std::is_same_v<Ranking, Bm25Ranking>) {
+            return 1;
+        } else {
+            return -1;
+        }
+    }
+};
+
+template <typename Ranking, typename ComputeWeight>
+double WordWeightCache::Get(uint64_t version, ComputeWeight compute_weight) const {
+    constexpr int slot = GetSlot<Ranking>();
+    if constexpr (slot < 0) {
+        return compute_weight();
+    } else {
+        if (versions_[slot].load(std::memory_order_acquire) == version) {
+            return weights_[slot].load(std::memory_order_relaxed);
+        }
+        const double weight = compute_weight();
+        weights_[slot].store(weight, std::memory_order_relaxed);
+        versions_[slot].store(version, std::memory_order_release);
+        return weight;
+    }
+}